@@ -4,34 +4,75 @@
 ** Date: October 29, 2016
 **
 ** Description: This program generates 7 rooms from a possible pool of 10 names, and gives
-** each room a start, middle, or end type. Each room is connected to 3-6 others rooms. 
+** each room a start, middle, or end type. Each room is connected to 3-6 others rooms.
 ** The program generates a directory, and a room file for each room. The program is a text
 ** based game, and when the game begins, it reads room data from each of the rooms, and stores
 ** the information into structures. Each turn, the user is given their location and a list of
 ** connections their room has, and they try to find the end room. After finding the end room,
 ** a message shows that they have won, and shows how many steps it took to get to the end
 ** and their path to victory.
-*************************/ 
+**
+** The size of the world can be changed when the program is started, for generating large test maps:
+** "foxed.adventure --rooms 1000000 --min-connections 2 --max-connections 4". Up to 10 rooms get names from
+** the pool, and bigger worlds number the names, like "Jaeru City 12". A world of millions of rooms is kept
+** in a few flat arrays, so it takes a few dozen bytes per room. Every room gets between the minimum and maximum
+** number of connections, and the end room can always be reached from the start room. "--seed N" generates the
+** same world every time, and the seed is saved in the world file.
+**
+** The world is kept in one binary world file, foxed.rooms.<pid>/world or the file given with --save, which the game
+** maps into memory and plays without reading the rooms one by one, so even huge worlds load right away. --load plays a
+** world file that was saved before, and --text also writes the old text room files into the directory.
+**
+** For testing, "--replay FILE" plays the moves in a file, one room name per line, without printing the rooms, and
+** exits with 0 only if they found the end room. "--solve" prints the shortest path through the world and its
+** diameter instead of playing, and "--batch N" generates N worlds in memory, with the seeds counting up from --seed,
+** and prints how long their shortest paths and diameters were, and how long it took.
+**
+** A batch runs on threads (--threads N, one per processor by default), so the program is compiled with
+** "gcc -o foxed.adventure foxed.adventure.c -lpthread". Every world in a batch is checked: the connections of every
+** room are within the limits and go both ways, and every room can be reached. "--archive FILE" writes the worlds
+** of a batch into one archive file, and "--load FILE --world K" plays world K of an archive.
+**
+** "--load FILE --serve ADDRESS" serves a world file or archive to many players at once, over TCP when ADDRESS is a
+** port number and over a Unix socket when it is a path, for example "nc localhost 4000" to play. Every player of a
+** world file plays the same world, and with an archive each player gets the next world of it.
+*************************/
+
+#define _GNU_SOURCE /* For accept4(), which makes a player's socket non-blocking as it is accepted. */
 
 #include <unistd.h> /* Needed for getpid(), which allows us to add the process id to the directory name. */
 #include <stdio.h> /* Needed for the file library functions such as fgets(), fopen(), and fclose() */
 #include <sys/stat.h> /* Needed for stats information of the file. */
 #include <string.h> /* For various string operations such as strcpy. */
-#include <stdlib.h> /* For rand and srand, in order to randomize room names, connections, etc. */
+#include <stdlib.h> /* For malloc() and exit(). */
 #include <time.h> /* Used to seed the randomizer based on the current time since January 1, 1970 */
+#include <stdint.h> /* For the fixed size integers of the world arrays. */
+#include <fcntl.h> /* For open(), to map a world file. */
+#include <sys/mman.h> /* For mmap(), which loads a world file. */
+#include <pthread.h> /* For the threads that generate a batch of worlds. */
+#include <errno.h> /* For the errors of the server's sockets. */
+#include <signal.h> /* To ignore SIGPIPE in the server. */
+#include <stdarg.h> /* For sessionPrintf(). */
+#include <sys/socket.h> /* For the sockets of the server. */
+#include <sys/un.h> /* For Unix sockets. */
+#include <netinet/in.h> /* For TCP sockets. */
+#include <sys/epoll.h> /* For waiting on every player's socket at once. */
 
 /* Below I define some constants based on the assignment requirements, such as the minimum and maximum
- * number of connections, and the number of rooms. This isn't strictly necessary, as we could simply 
- * hard code the numbers, but this allows some flexibility in design for the future, so it is probably
- * good practice. */
+ * number of connections, and the number of rooms. These are now only the defaults, since the options
+ * --rooms, --min-connections and --max-connections can change all three when the program starts. */
 
-#define NUMBER_OF_ROOMS 7 /* Each game has 7 rooms. */
+#define DEFAULT_ROOMS 7 /* Each game has 7 rooms, unless --rooms says otherwise. */
 #define NUMBER_OF_NAMES 10 /* The names of the 7 rooms are selected out of 10 possible names. */
-#define MAX_CONNECTIONS 6 /* Each room has a maximum of 6 connections, which would connect it to each of the other 6 rooms, as a room can't be connected to itself.*/
-#define NAME_BUFFER 14 /* This is probably the least intuitive of the constant definitions. 14 is the longest length of any of the 10 names, plus 1 space for the '\0' null
-			* terminator character. The longest length is 13, shared between Seashore City and Castro Valley. */
-
-/* Below, I create an array of constant character pointers to the 10 possible names that a room can have. 
+#define DEFAULT_MIN_CONNECTIONS 3 /* Each room has at least 3 connections. */
+#define DEFAULT_MAX_CONNECTIONS 6 /* Each room has a maximum of 6 connections, which would connect it to each of the other 6 rooms, as a room can't be connected to itself.*/
+#define BATCH_CHUNK 16 /* How many worlds a thread takes at a time in a batch. */
+#define NAME_CAPACITY 26 /* The most bytes the name of a room takes: the longest name, a space, a ten digit number and the terminator. */
+#define SESSION_LINE 64 /* The longest move a player can send, which is longer than any name of a room. */
+#define SERVER_EVENTS 256 /* How many sockets the server handles each time it wakes up. */
+#define EXACT_DIAMETER_ROOMS 2048 /* Bigger worlds only get a lower bound of their diameter, since the exact one takes a search from every room. */
+
+/* Below, I create an array of constant character pointers to the 10 possible names that a room can have.
  * It makes sense to make this array const because it should be impossible to change the list of names.
  * The assignment specifications say to hard code the names. I based my possible room names based off of
  * possible locations in the Rijon region in Pokemon Brown and Pokemon Prism, which are romhacks. Coincidentally,
@@ -42,7 +83,7 @@
 
 /* Before we can create the room structure, we enumerate a custom variable type called roomType, with the three possible room types,
  * START_ROOM, END_ROOM, and MID_ROOM, as specified byt he assignment requirements. Enumeration makes sense for self-documenting purposes,
- * but also because there are only 3 possible values for the roomType variable. */
+ * but also because there are only 3 possible values for the roomType variable. typeNames holds how each type is written in a room file. */
 
 enum roomType
 {
@@ -51,243 +92,551 @@ enum roomType
 	MID_ROOM
 };
 
-/* We now create a room structure with name, type, connection, and number of connection attributes. Name is an array of characters, with 
- * length capped by the NAME_BUFFER constant, whose purpose is explained above. Type is from the enumerated type, and finally we have an
- * array of integers representing the connections to other rooms, capped by the max connections. I was debating between an array of integers
- * and an array of room structures, but I didn't want to add additional complexity. */
+char *typeNames[] = {"START_ROOM", "END_ROOM", "MID_ROOM"};
+
+/* The player picks where to go by typing the name of a room, so the names are looked up in a hash table, the name index, instead of
+ * being compared with every room. It is an array of room numbers with NO_ROOM in the empty slots, at least half again as big as the
+ * number of rooms and always a power of two. A name goes in the slot its hash points at, or the next empty one after it. The index is
+ * built when a world is generated, and saved in the world file with everything else, so loading still does not touch the rooms. */
+
+#define NO_ROOM UINT32_MAX
+
+/* The rooms used to be an array of room structures, each with a name, a 100 character type and room for 6 connections. That does not
+ * scale to millions of rooms, so the world is now kept as a handful of flat arrays instead, indexed by room number:
+ *
+ *   The connections are in compressed sparse row form. The rooms connected to room r are connections[connectionStart[r]] up to, but
+ *   not including, connections[connectionStart[r + 1]], so the number of connections of a room is the difference of the two.
+ *   The names are all in one pool of characters, one after the other with their null terminators, and room r's name starts at
+ *   names + nameStart[r].
+ *   The type of each room is one byte.
+ *
+ * This takes a few dozen bytes per room, and every array can be allocated, and later written or mapped, in one piece. */
+
+struct world
+{
+	uint32_t numberOfRooms;
+	uint32_t startRoom; /* The room the player starts in. */
+	uint32_t endRoom; /* The room the player is looking for. */
+	uint64_t seed; /* That the world was generated from. */
+	uint32_t *connectionStart; /* numberOfRooms + 1 entries. */
+	uint32_t *connections;
+	uint32_t *nameStart;
+	char *names;
+	uint8_t *types; /* Each one is a roomType. */
+	uint32_t *nameIndex; /* The hash table from names to rooms, with indexSize slots. */
+	uint32_t indexSize;
+	uint32_t *connectionCount; /* Only while the connections are being generated, how many each room has so far. */
+	uint32_t *connectionTarget; /* And how many each room is meant to end up with. */
+	char *mapping; /* The world file the arrays point into, or NULL if they were generated. */
+	size_t mappingSize;
+};
+
+/* A world is kept in a world file, which is the arrays above written out one after the other, so that it can be mapped into memory
+ * and used as it is. The room files used to be text, one per room, which had to be read line by line and have every connection looked
+ * up by name. The header starts with WORLD_MAGIC and the version, which changes whenever the layout does, and byteOrder, which only
+ * reads right on a computer with the same byte order as the one that wrote it. Then come the counts, the seed, and where each section is in the
+ * file: connectionStart, connections, nameStart, names, types and nameIndex, in that order. */
+
+#define WORLD_MAGIC "FOXWORLD"
+#define WORLD_VERSION 3
+#define WORLD_BYTE_ORDER 0x01020304
+#define WORLD_SECTIONS 6
+
+struct worldSection
+{
+	uint64_t offset; /* From the start of the file, always a multiple of 8. */
+	uint64_t size; /* In bytes. */
+};
+
+struct worldHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t numberOfRooms;
+	uint32_t startRoom;
+	uint32_t endRoom;
+	uint32_t numberOfConnections; /* Counting each connection once from each end. */
+	uint32_t indexSize; /* Slots in the name index. */
+	uint32_t reserved; /* Always 0. Keeps what comes after on a multiple of 8. */
+	uint64_t namesSize; /* In bytes, including the terminators. */
+	uint64_t fileSize;
+	uint64_t seed; /* That the world was generated from, so it can be generated again. */
+	struct worldSection sections[WORLD_SECTIONS];
+};
+
+/* A batch of worlds can be written into one archive file, instead of a directory for each world. The archive header is followed by a
+ * table with an entry for every world of the batch, in the order of their seeds, and then the worlds themselves, each a world file
+ * as above starting on a multiple of 8 bytes. A world that failed its checks has an entry with a size of 0, and is not in the file.
+ * Every world of a batch has the same amount of space set aside for it, as much as the biggest world the options allow, so where a
+ * world goes only depends on its number. The space a world does not use is left as a hole, which takes no room on the disk. */
+
+#define ARCHIVE_MAGIC "FOXARCHV"
+#define ARCHIVE_VERSION 2
+
+struct archiveHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder; /* WORLD_BYTE_ORDER, like a world file. */
+	uint32_t numberOfWorlds; /* Entries in the table. */
+	uint32_t reserved; /* Always 0. */
+};
+
+struct archiveEntry
+{
+	uint64_t offset; /* Where the world file starts in the archive. */
+	uint64_t size; /* Of the world file, or 0 if it is not in the archive. */
+	uint64_t seed; /* That the world was generated from. */
+};
+
+/* Everything random about a world comes from its own random state, which starts from the seed. Two worlds generated from the same seed
+ * and options are the same, which makes it possible to generate a world again, for example one that showed a problem. The state is
+ * that of xoshiro256**, which is fast, has 256 bits of state, and passes the statistical tests that rand() fails. The seed is
+ * spread over the state with splitmix64, so seeds that are close together, like the seeds of a batch, still give unrelated worlds. */
+
+struct randomState
+{
+	uint64_t s[4];
+};
+
+/* The options the program was started with, or their defaults. */
+
+struct options
+{
+	uint32_t numberOfRooms;
+	uint32_t minConnections;
+	uint32_t maxConnections;
+	uint64_t seed; /* From --seed, or the time and process id by default. */
+	char *loadFile; /* From --load, the world file to play instead of generating one. */
+	char *saveFile; /* From --save, where to write the world file. */
+	int text; /* 1 with --text, which also writes the rooms as text files. */
+	char *replayFile; /* From --replay, the moves to play instead of reading them from the player. */
+	int solve; /* 1 with --solve, which solves the world instead of playing it. */
+	uint32_t batch; /* From --batch, how many worlds to generate and solve, or 0 to play one. */
+	uint32_t threads; /* From --threads, how many threads generate the batch. */
+	char *archiveFile; /* From --archive, where to write the worlds of the batch. */
+	uint32_t worldNumber; /* From --world, which world of an archive to load. */
+	char *serveAddress; /* From --serve, the port or Unix socket to serve players on. */
+};
+
+/* What the threads of a batch share, which is only ever changed with the lock held. */
+
+struct batch
+{
+	struct options *options;
+	pthread_mutex_t lock;
+	uint32_t nextWorld; /* The first world that no thread has taken yet. */
+	int archivefd; /* The archive being written, or -1. */
+	uint64_t firstWorld; /* Where the place of the first world starts in the archive. */
+	uint64_t worldSpace; /* How many bytes each world has set aside for it, so world K always starts at firstWorld + K * worldSpace. */
+	struct archiveEntry *entries; /* The table of the archive, which each thread fills in for its own worlds. */
+};
+
+/* Each thread of a batch keeps its own totals, which are added together once it is done. */
+
+struct batchWorker
+{
+	struct batch *batch;
+	pthread_t thread;
+	double generateSeconds, solveSeconds; /* Time spent by this thread. */
+	uint32_t solved, failed; /* How many worlds passed their checks, and how many did not. */
+	uint32_t minimumSteps, maximumSteps, minimumDiameter, maximumDiameter;
+	double totalSteps, totalDiameter;
+	int exact; /* 1 if every diameter was exact. */
+	int writeFailed; /* 1 if a world could not be written to the archive. */
+};
+
+/* A player of the server. Only what is different for every player is kept here, and the worlds are shared. The path and the output
+ * are only allocated while they are needed, so a player who is thinking costs little more than this. */
 
-struct room
+struct session
 {
-	char name[NAME_BUFFER]; /* Decided to not make this constant so it can be modified. Only the master list of names needs to be unmodifiable. */
-				/* Length capped by the NAME_BUFFER constant above. */
-	char type[100]; /* By definition has the values START_ROOM, END_ROOM, or MID_ROOM.*/ 
-	int connections[MAX_CONNECTIONS]; /* While we could hard code it as "int connections[6]", I decided to use MAX_CONNECTIONS definition for future flexibility.*/
-	int numberOfConnections; /* This stores the number of connections the room actually has. */
+	int fd; /* The player's socket. */
+	uint32_t world; /* Which world of the server. */
+	uint32_t room; /* Where the player is. */
+	uint32_t steps; /* How many steps they took, which are in path. */
+	uint32_t pathCapacity;
+	uint32_t *path;
+	char *output; /* What is waiting to be sent to the player. */
+	size_t outputSize, outputSent, outputCapacity;
+	unsigned char lineLength; /* Of the move that is still coming in. */
+	unsigned char lineTooLong; /* 1 if it is longer than the line. */
+	unsigned char waiting; /* 1 while waiting for the socket to take more output. */
+	unsigned char finished; /* 1 once the player found the end room, and only the output is left to send. */
+	char line[SESSION_LINE];
 };
 
-struct room roomsList[NUMBER_OF_ROOMS]; /* This creates an array of room structs, up to the total number of rooms as defined above. */
+/* The server, with the worlds it serves out of one mapping, and the sessions, kept by socket. */
+
+struct server
+{
+	char *fileName;
+	char *mapping;
+	size_t mappingSize;
+	struct world *worlds; /* One for every world of the file, filled in when a session first gets it. */
+	uint32_t numberOfWorlds;
+	uint32_t nextWorld; /* The world the next session gets. */
+	int listenfd, epollfd;
+	int listening; /* 1 while new players are being taken. */
+	struct session **sessions;
+	size_t sessionSlots; /* How many sockets sessions has room for. */
+	uint32_t numberOfSessions;
+};
 
 /* Here I place function prototypes for functions that will be used in main. */
 
+void readOptions(int argc, char *argv[], struct options *options); /* Reads the command line options. */
 void swapStrings(char *array[], int x, int y); /* Swaps string array elements. */
-void swapInts(int array[], int x, int y); /* Swaps integer array elements. */
-void createRoomFile(struct room r, int roomNumber); /* Creates room files from room structures. */
-void readType(struct room *r, int roomNumber); /* Reads the type of the room from the file. */
-void readConnections(struct room *r, int roomNumber);
-
-int main(void)
+void swapRooms(uint32_t array[], size_t x, size_t y); /* Swaps room number array elements. */
+void seedRandom(struct randomState *random, uint64_t seed); /* Starts a random state from a seed. */
+uint64_t nextRandom(struct randomState *random); /* Returns the next 64 random bits. */
+uint32_t randomNumber(struct randomState *random, uint32_t bound); /* Returns a random number below bound. */
+char *roomName(struct world *w, uint32_t room); /* Returns the name of a room. */
+uint32_t numberOfConnections(struct world *w, uint32_t room); /* Returns how many connections a room has. */
+uint32_t findRoom(struct world *w, char *name); /* Returns the room with a name. */
+uint32_t hashName(char *name); /* Returns the hash of a name, for the name index. */
+uint32_t nameIndexSize(uint32_t numberOfRooms); /* Returns how many slots the name index has. */
+void buildNameIndex(struct world *w); /* Fills in the name index. */
+void generateNames(struct world *w, struct randomState *random); /* Names the rooms and sets their types. */
+int generateConnections(struct world *w, uint32_t minConnections, uint32_t maxConnections, struct randomState *random); /* Connects the rooms. */
+uint32_t pathConnections(struct world *w, uint32_t room); /* How many connections the path gives a room. */
+int connected(struct world *w, uint32_t a, uint32_t b); /* Checks whether two rooms are connected. */
+void addConnection(struct world *w, uint32_t a, uint32_t b); /* Connects two rooms. */
+void removeConnection(struct world *w, uint32_t a, uint32_t b); /* Disconnects two rooms. */
+int fixRoom(struct world *w, uint32_t room, struct randomState *random); /* Gives a room one more connection. */
+int hasFreeSlot(struct world *w, uint32_t room); /* Checks whether a room can take another connection. */
+void createRoomFile(struct world *w, char *directoryName, uint32_t room); /* Creates room files from the world. */
+void writeWorld(struct world *w, char *fileName); /* Writes a world file. */
+void fillHeader(struct world *w, struct worldHeader *header); /* Fills in the header of a world file. */
+int writeSections(struct world *w, struct worldHeader *header, int filefd, off_t base); /* Writes a world file into a file. */
+void sectionOffsets(struct worldHeader *header); /* Works out where the sections of a world file go. */
+int loadWorld(struct world *w, char *fileName, uint32_t worldNumber); /* Maps a world file, or a world of an archive. */
+int mapWorldFile(char *fileName, char **mapping, size_t *size); /* Maps a whole world file or archive. */
+int openWorld(struct world *w, char *fileName, char *mapping, size_t mappingSize, uint32_t worldNumber); /* Points a world into a mapping. */
+int checkSections(struct worldHeader *header, char *start); /* Checks that the sections of a world file only point inside the world. */
+void freeWorld(struct world *w); /* Gives back the memory of a world. */
+int playGame(struct world *w, FILE *input, int interactive); /* Plays a world. */
+uint32_t shortestPath(struct world *w, uint32_t *path); /* Finds the shortest path from the start room to the end room. */
+uint32_t eccentricity(struct world *w, uint32_t from, uint32_t *distance, uint32_t *queue, uint32_t *farthest); /* How far the farthest room is. */
+uint32_t diameter(struct world *w, int *exact); /* The longest shortest path between two rooms. */
+double secondsSince(struct timespec *start); /* Times the solver. */
+int solveWorld(struct world *w); /* Prints the solution of a world. */
+int runBatch(struct options *options); /* Generates and solves many worlds. */
+void *batchWorker(void *argument); /* Generates and solves some of the worlds of a batch. */
+const char *validateWorld(struct world *w, uint32_t minConnections, uint32_t maxConnections); /* Checks a world. */
+int runServer(struct options *options); /* Serves worlds to players over sockets. */
+int listenOn(char *address); /* Makes the listening socket. */
+void watchListener(struct server *server, int on); /* Starts or stops taking new players. */
+void acceptSessions(struct server *server); /* Starts sessions for new players. */
+int pickWorld(struct server *server, struct session *session); /* Gives a session its world. */
+void readSession(struct server *server, struct session *session); /* Reads the moves of a player. */
+void moveSession(struct server *server, struct session *session); /* Makes one move. */
+void describeRoom(struct server *server, struct session *session); /* Shows a player where they are. */
+void sessionPrintf(struct session *session, const char *format, ...); /* Adds to what is sent to a player. */
+void flushSession(struct server *server, struct session *session); /* Sends what is waiting for a player. */
+void closeSession(struct server *server, struct session *session); /* Ends a session. */
+
+int main(int argc, char *argv[])
 {
-	srand(time(NULL)); /* Seed the randomizer with the time since January 1, 1970, for standardized unique results. */
+	struct options options; /* What the program was asked to generate. */
+	struct world world; /* The rooms of this game. */
+
+	readOptions(argc, argv, &options);
+	struct randomState random;
+
+	seedRandom(&random, options.seed); /* Seed the randomizer with --seed, or the time and process id. */
 
 
 	/* First, I create the variables I will need for the game. */
 
-	int pathTaken[1000]; /* 1000 steps to solve a 7 room maze should be enough for most, and I doubt the graders will waste time trying to exhaust this very generous limit. */
-	int i, j, k; /* Loop control variables */
-	int numberOfUsedRooms; /* This variable assists in creating connections between rooms, and keeps track of how many rooms have yet to be connected with the current room. */
+	uint32_t i; /* Loop control variable */
 	int processID; /* This variable stores the process id so we can make a directory including the process id. */
 	char directoryName[100]; /* Used to store the directory name. */
-	char inputBuffer[100];
-	char *newline;
+	FILE *moves; /* The moves for --replay. */
 
-	/* This section of the code makes the directory. */
+	/* Unless a world file was given with --load, we generate a world and write it to a world file, which goes in a new directory
+	   unless --save says where. The text room files are only written with --text, into the same directory. Either way, the game then
+	   plays the world from the world file. */
 
-	processID = getpid(); /* Uses the getpid () function to determine the process id of the process, as we are making the directory now. */
-	sprintf(directoryName, "foxed.rooms.%d", processID); /* Uses sprintf to add the process id to the assignment specified format and store it in directory name. */
-	if (mkdir(directoryName, 0755) == -1) /* This attempts to call mkdir using the directory Name. The permissions 0755 allow me all permissions, and everyone else read and execute permissions, but not write. */
+	if (options.batch > 0) /* --batch only generates, checks and solves worlds, and writes no files except the archive. */
 	{
-		perror("Error. Could not create directory."); /* If there is an error, it will equal -1, and use perror to print this error message, then exit the entire program with a code of 1 */
-		exit(1); /* The program needs to exit because it is dependent on being able to create the directory. */
+		exit(runBatch(&options));
 	}
 
-	chdir(directoryName); /* chdir used to change the working directory of the program. */
-
-	/* This section of the code assigns a name and type to each of the 7 rooms.
-	 * I was trying to think of how I could uniquely assign names without re-using any.
-	 * In a for loop, I decide to create a random number from 0 to 9, corresponding to the indexes of the roomNames array.*/
+	if (options.serveAddress != NULL) /* The server maps the world file or archive itself, and only returns if it could not start. */
+	{
+		exit(runServer(&options));
+	}
 
-	for (i = 0; i < NUMBER_OF_ROOMS; i++) /* Perform this procedure to assign a name to each room. */
+	if (options.loadFile == NULL)
 	{
-		int randomNumber = ((rand() % NUMBER_OF_NAMES));
-		char *chosenName; /* create a variable to store the name that will eventually be chosen for the room. */
+		char worldFileName[4096]; /* Where the world file goes. */
 
-		swapStrings(roomNames, randomNumber, (NUMBER_OF_NAMES - i - 1)); /* Swap the element of the randomized number with numberOfNames - i - 1. This ensures
-										  * randomized names are not reused. */
-		chosenName = roomNames[NUMBER_OF_NAMES - i - 1]; /* After the above swapping, we store the chosen name into, well, the chosenName variable. */
-		strcpy(roomsList[i].name, chosenName); /* Copies the chosen name into the name field of the room structure. */
-		strcpy(roomsList[i].type, "MID_ROOM");  /* Initially, we are setting the type of each room to MID_ROOM, and will manually change 2 of the rooms to START_ROOM and END_ROOM types.	*/
-	}
+		processID = getpid(); /* Uses the getpid () function to determine the process id of the process, as we are making the directory now. */
+		sprintf(directoryName, "foxed.rooms.%d", processID); /* Uses sprintf to add the process id to the assignment specified format and store it in directory name. */
 
-	strcpy(roomsList[0].type, "START_ROOM");  /* Set the first room in the list of rooms to have the START_ROOM type. */
-	strcpy(roomsList[NUMBER_OF_ROOMS - 1].type, "END_ROOM");  /* Set the final room in the list of rooms to have the END_ROOM type. */
+		if ((options.saveFile == NULL || options.text == 1) && mkdir(directoryName, 0755) == -1) /* This attempts to call mkdir using the directory Name. The permissions 0755 allow me all permissions, and everyone else read and execute permissions, but not write. */
+		{
+			perror("Error. Could not create directory."); /* If there is an error, it will equal -1, and use perror to print this error message, then exit the entire program with a code of 1 */
+			exit(1); /* The program needs to exit because it is dependent on being able to create the directory. */
+		}
 
-	/* In this section, we create the connections for each room. For each room, we create an array of unused room numbers, and keep a count of how many rooms haven't been used.
-	 * For each room, the array will give the numbers of all the unused rooms. Then, up until the number of connections, elements from the unused array are randomly connected to the main room. */
+		/* This section of the code assigns a name and type to each room, and then connects them. */
 
-	for (i = 0; i < NUMBER_OF_ROOMS; i++)
-	{
-		int unusedRooms[NUMBER_OF_ROOMS]; /* create an array to hold all the rooms that the current room hasn't connected to. */
-		int numberOfUnusedRooms = 0; /* Set the initial number of unused rooms to 0, until we calculate the total for the given room. */
+		world.numberOfRooms = options.numberOfRooms;
+		world.mapping = NULL;
+		world.seed = options.seed;
+		generateNames(&world, &random);
 
-		for (j = 0; j < NUMBER_OF_ROOMS; j++) /* Using a nested loop, we fill the unusedRooms array with every room number but the current room. */
+		if (generateConnections(&world, options.minConnections, options.maxConnections, &random) == -1)
 		{
-			if (j != i)
-			{
-				unusedRooms[numberOfUnusedRooms] = j; /* Goes through every room and adds it to the array unless it is the current room. */
-				numberOfUnusedRooms++; /* Increment the count of used rooms by 1. */
-			}
+			fprintf(stderr, "Could not give every room between %u and %u connections. Try other limits.\n", options.minConnections, options.maxConnections);
+			exit(1);
 		}
 
-		/* Now that the array of unused rooms for each room has been filled, we exit the nested loop and back into the initial loop. Here we determine the number of connections and
-		 * randomly assign room numbers as connections from the unUusedRooms array. */
+		buildNameIndex(&world);
 
-		int numberOfConnections = ((rand() % 4) + 3); /* Sets the number of connections to a random number between 3 and 6. */
-		roomsList[i].numberOfConnections = numberOfConnections; /* Sets the number of connections in the structure of the given room to the randomly determined number. */
+		snprintf(worldFileName, sizeof(worldFileName), "%s/world", directoryName);
+		options.loadFile = (options.saveFile != NULL) ? options.saveFile : worldFileName;
+		writeWorld(&world, options.loadFile);
+
+		for (i = 0; options.text == 1 && i < world.numberOfRooms; i++) /* For each room, create a room file. */
+		{
+			createRoomFile(&world, directoryName, i);
+		}
 
-		/* We now create a second loop using j again (set to 0) in order to populate the connections of a room, randomly from the pool of unused rooms that a particular room has. */
+		freeWorld(&world);
 
-		for (j = 0; j < roomsList[i].numberOfConnections; j++)
+		if (loadWorld(&world, options.loadFile, 0) == -1)
 		{
-			int randomNumber = rand() % numberOfUnusedRooms; /* This will generate a number between 0 and the number of rooms (besides the current room), which corresponds perfectly with
-									* the indexes of the unusedRooms array. */
-			roomsList[i].connections[j] = unusedRooms[randomNumber]; /* Populate the connections array with a random element from the unusedRooms array. */
-			swapInts(unusedRooms, randomNumber, numberOfUnusedRooms - 1); /* Swap between the random number and the last index that hasn't been inolved in the swaps yet.
-											   * This helps to prevent duplicate connections. */
-			numberOfUnusedRooms--; /* Since a connection has been made, decrease the number of unused rooms by one, as a connection makes a room used. */
+			exit(1);
 		}
 	}
 
-	/* We now add a second for loop in order to ensure that the connections are two way. For example, if Seashore City is connected to Hayward City, we must also
-	 * ensure that Hayward City is connected to Seashore City. We actually need to do a triple nested loop in order to accomplish this. */
+	else if (loadWorld(&world, options.loadFile, options.worldNumber) == -1)
+	{
+		exit(1);
+	}
 
-	int connected = 0; /* This is a boolean variable that is 0 if there isn't a 2 way connection, and 1 if there is. By default, we keep it at 0. */
-	int adjacentRoom; /* This variable will be used to represent the room next to the current room that we are checking for the 2 way connection. */
+	/* Then the world is solved, or played with the moves from --replay, or played by the player. */
 
+	if (options.solve == 1)
+	{
+		exit(solveWorld(&world));
+	}
 
-	for (i = 0; i < NUMBER_OF_ROOMS; i++) /* For each room. */
+	if (options.replayFile != NULL)
 	{
-		for (j = 0; j < roomsList[i].numberOfConnections; j++) /* For each connection in each room. */
-		{
-			adjacentRoom = roomsList[i].connections[j]; /* Check each connection to each room. */
-			for (k = 0; k < roomsList[adjacentRoom].numberOfConnections; k++) /* For each adjacent room, check all of their connections. */
-			{
-				if (roomsList[adjacentRoom].connections[k] == i) /* If the adjacent room has a connection to the original room, set the connected variable to true. */
-				{
-					connected = 1;
-				}
-			}
+		moves = fopen(options.replayFile, "r");
 
-			if (connected == 0) /* If the adjacent room has no connection to the original room, we add one. */
-			{
-				roomsList[adjacentRoom].connections[roomsList[adjacentRoom].numberOfConnections] = i; /* Form a connection between the adjacent room and the original room. */
-				roomsList[adjacentRoom].numberOfConnections++; /* Increase the number of connections for the adjacent room by 1. */
-			}
+		if (moves == NULL)
+		{
+			perror("Error: could not open the moves.");
+			exit(1);
 		}
-	}
 
-	for (i = 0; i < NUMBER_OF_ROOMS; i++) /* For each room, create a room file. */
-	{
-		createRoomFile(roomsList[i], i + 1);
+		exit(playGame(&world, moves, 0));
 	}
 
-	int currentRoom; /* Holds the index of the current room. */
-	int nextRoom; /* Holds the index of the next room. */
-	int endRoom; /* Holds the index of the final room. */
+	playGame(&world, stdin, 1);
+	exit(0); /* Exit with a code of 0, whether the end room was found or the player stopped. */
+}
+
+/* The readOptions function reads --load, --save, --text, --replay, --solve, --archive and --serve, and --rooms, --min-connections,
+ * --max-connections, --seed, --batch, --threads and --world, each followed by a number, and checks that a world can be made with
+ * them: there have to be at least 2 rooms, so the start and end rooms are different, a room cannot have more connections than there
+ * are other rooms, and with more than 2 rooms there has to be room for 2 connections, so that a path can go through a room. When
+ * every room has the same odd number of connections, the number of rooms has to be even, since every connection has two ends.
+ * Anything else prints how to use the program and exits. */
 
-	for (i = 0; i < NUMBER_OF_ROOMS; i++)
+void readOptions(int argc, char *argv[], struct options *options)
+{
+	int i; /* Loop control variable. */
+	struct timespec now;
+
+	clock_gettime(CLOCK_REALTIME, &now); /* Down to the nanosecond, and with the process id, so programs started together differ. */
+	options->numberOfRooms = DEFAULT_ROOMS;
+	options->minConnections = DEFAULT_MIN_CONNECTIONS;
+	options->maxConnections = DEFAULT_MAX_CONNECTIONS;
+	options->seed = ((uint64_t)now.tv_sec * 1000000000 + now.tv_nsec) ^ ((uint64_t)getpid() << 40);
+	options->loadFile = NULL;
+	options->saveFile = NULL;
+	options->text = 0;
+	options->replayFile = NULL;
+	options->solve = 0;
+	options->batch = 0;
+	options->threads = sysconf(_SC_NPROCESSORS_ONLN);
+	options->archiveFile = NULL;
+	options->worldNumber = 0;
+	options->serveAddress = NULL;
+
+	for (i = 1; i < argc; i++)
 	{
-		readType(&roomsList[i], i + 1); /* For each room, read the type from the file. */
+		uint32_t *setting = NULL; /* The option the number after this argument goes into. */
+		char *end = NULL; /* Where the number stopped, to check that it was all a number. */
+		unsigned long value = 0;
 
-		if (strcmp(roomsList[i].type, "START_ROOM") == 0) /* If the read room is the starting room, set the starting room as the current room. */
+		if (strcmp(argv[i], "--load") == 0 && i + 1 < argc)
 		{
-			currentRoom = i;
+			options->loadFile = argv[++i];
+			continue;
 		}
 
-		if (strcmp(roomsList[i].type, "END_ROOM") == 0) /* When the end room is found, set that as the end room. */
+		if (strcmp(argv[i], "--save") == 0 && i + 1 < argc)
 		{
-			endRoom = i;
+			options->saveFile = argv[++i];
+			continue;
 		}
 
-		readConnections(&roomsList[i], i + 1); /* Read the connections of the room. */
-	}
+		if (strcmp(argv[i], "--text") == 0)
+		{
+			options->text = 1;
+			continue;
+		}
 
-	int stepCount = 0; /* Will record how many steps are taken on the journey. */
+		if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+		{
+			options->replayFile = argv[++i];
+			continue;
+		}
 
-	for (;;)
-	{
-		printf("CURRENT LOCATION: %s\n", roomsList[currentRoom].name); /* Print current location then the current rooms name, and new line. */
-		printf("POSSIBLE CONNECTIONS: "); /* Write "POSSIBLE CONNECTIONS: */
-		for (i = 0; i < roomsList[currentRoom].numberOfConnections; i++)
+		if (strcmp(argv[i], "--archive") == 0 && i + 1 < argc)
 		{
-			printf("%s", roomsList[roomsList[currentRoom].connections[i]].name); /* For each connection, write the name of the connection. */
-			if (i == roomsList[currentRoom].numberOfConnections - 1) /* If it is the last connection, add a period, then a new line. */
-			{
-				printf(".\n");
-			}
+			options->archiveFile = argv[++i];
+			continue;
+		}
+
+		if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc)
+		{
+			options->serveAddress = argv[++i];
+			continue;
+		}
+
+		if (strcmp(argv[i], "--solve") == 0)
+		{
+			options->solve = 1;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) /* The seed has 64 bits, unlike the other numbers. */
+		{
+			options->seed = strtoull(argv[++i], &end, 10);
 
-			else /* If it isn't the last connection, add a period, then a space. */
+			if (end != argv[i] && *end == '\0' && argv[i][0] != '-')
 			{
-				printf(", ");
+				continue;
 			}
+
+			end = NULL; /* Not a number, so the usage is printed below. */
 		}
 
-		printf("WHERE TO? >"); /* Prints the where to prompt, with the cursor right outside the arrow key. */
-		fflush(stdout); /* Flush the standard output to properly read the input from the user. */
+		else if (strcmp(argv[i], "--rooms") == 0)
+		{
+			setting = &options->numberOfRooms;
+		}
 
-		if (fgets(inputBuffer, 100, stdin) == NULL) /* Read input from user. */
+		else if (strcmp(argv[i], "--min-connections") == 0)
 		{
-			printf("\n");
-			exit(0);
+			setting = &options->minConnections;
 		}
 
-		newline = strchr(inputBuffer, '\n');
-		*newline = '0'; /* Replace newline from read string with null terminator. */
-		printf("\n"); /* Print new line anyway to space out the text. */
+		else if (strcmp(argv[i], "--max-connections") == 0)
+		{
+			setting = &options->maxConnections;
+		}
 
-		for (i = 0; i < NUMBER_OF_ROOMS; i++)
+		else if (strcmp(argv[i], "--batch") == 0)
 		{
-			if (strcmp(inputBuffer, roomsList[i].name) == 0) /* Searches each room's name structures for a string matching the name of the connection. */
-			{
-				nextRoom = i; /* If matching room found, set the nextRoom equal to the room that corresponds to the name of the connection. */
-			}
+			setting = &options->batch;
 		}
 
-		for (i = 0; i < NUMBER_OF_ROOMS; i++)
+		else if (strcmp(argv[i], "--threads") == 0)
 		{
-			if (strcmp(roomsList[roomsList[currentRoom].connections[i]].name, inputBuffer))
-			{
-				nextRoom = -1; /* If the strings of any room aren't equal to the string from the input buffer, set the next room as invalid.*/
-			}
+			setting = &options->threads;
 		}
 
-		if (nextRoom == -1)
+		else if (strcmp(argv[i], "--world") == 0)
 		{
-			printf("HUH? I DON'T UNDERSTAND THAT ROOM. TRY AGAIN.\n\n");
+			setting = &options->worldNumber;
 		}
 
-		else
+		if (setting != NULL && i + 1 < argc)
 		{
-			currentRoom = nextRoom;
-			pathTaken[stepCount] = currentRoom;
-			stepCount++;
+			value = strtoul(argv[++i], &end, 10);
+		}
 
-			if (currentRoom == endRoom)
-			{
-				printf("YOU HAVE FOUND THE END ROOM. CONGRATULATIONS!\n");
-				printf("YOU TOOK %d STEPS. YOUR PATH TO VICTORY WAS:\n", stepCount);
+		if (end == NULL || end == argv[i] || *end != '\0' || value > UINT32_MAX)
+		{
+			fprintf(stderr, "usage: %s [--rooms N] [--min-connections N] [--max-connections N] [--seed N] [--save file] [--text] | --load file [--world K]\n"
+				"       [--replay moves | --solve | --serve port-or-socket | --batch N [--threads N] [--archive file]]\n", argv[0]);
+			exit(1);
+		}
 
-				for (i = 0; i < stepCount; i++)
-				{
-					printf("%s\n", roomsList[pathTaken[i]].name);
-				}
+		*setting = value;
+	}
 
-				exit(0); /* Exit with a code of 0 if successful.*/
-			}
-		}
+	if (options->batch > 0 && (options->loadFile != NULL || options->saveFile != NULL || options->text == 1 || options->replayFile != NULL || options->solve == 1))
+	{
+		fprintf(stderr, "--batch generates its own worlds, and cannot be used with --load, --save, --text, --replay or --solve.\n");
+		exit(1);
+	}
+
+	if (options->serveAddress != NULL && options->loadFile == NULL)
+	{
+		fprintf(stderr, "--serve serves the world file or archive from --load.\n");
+		exit(1);
+	}
+
+	if (options->archiveFile != NULL && options->batch == 0)
+	{
+		fprintf(stderr, "--archive writes the worlds of a --batch.\n");
+		exit(1);
+	}
+
+	if (options->threads < 1)
+	{
+		options->threads = 1;
+	}
+
+	if (options->threads > options->batch && options->batch > 0) /* There is no use for more threads than worlds. */
+	{
+		options->threads = options->batch;
+	}
+
+	if (options->numberOfRooms < 2)
+	{
+		fprintf(stderr, "There have to be at least 2 rooms.\n");
+		exit(1);
+	}
+
+	if (options->minConnections < 1 || options->minConnections > options->maxConnections || options->maxConnections > options->numberOfRooms - 1)
+	{
+		fprintf(stderr, "Every room needs between 1 and %u connections, and the minimum cannot be more than the maximum.\n", options->numberOfRooms - 1);
+		exit(1);
+	}
+
+	if ((uint64_t)options->numberOfRooms * options->maxConnections > UINT32_MAX) /* Connections are counted in 32 bits, in memory and in the world file. */
+	{
+		fprintf(stderr, "%u rooms with up to %u connections each is more than %u connections in all.\n", options->numberOfRooms,
+			options->maxConnections, UINT32_MAX);
+		exit(1);
+	}
+
+	if (options->numberOfRooms > 2 && options->maxConnections < 2)
+	{
+		fprintf(stderr, "With more than 2 rooms, rooms need to allow 2 connections, so that the end room can be reached.\n");
+		exit(1);
+	}
+
+	if (options->minConnections == options->maxConnections && options->minConnections % 2 == 1 && options->numberOfRooms % 2 == 1)
+	{
+		fprintf(stderr, "An odd number of rooms cannot all have %u connections.\n", options->minConnections);
+		exit(1);
 	}
 }
 
-/* The swapStrings function applies the basic swap scenario to arrays of c-string elements, using the 
+/* The swapStrings function applies the basic swap scenario to arrays of c-string elements, using the
  * classic Temp = A, A = B, B = Temp formula. */
 
 void swapStrings(char *array[], int x, int y)
@@ -299,119 +648,2080 @@ void swapStrings(char *array[], int x, int y)
 	return;
 }
 
-void swapInts(int array[], int x, int y) /* Here, we perform the same procedure that we did in the above swapStrings function, just applying to ints instead of char pointers. */
+void swapRooms(uint32_t array[], size_t x, size_t y) /* Here, we perform the same procedure that we did in the above swapStrings function, just applying to room numbers instead of char pointers. */
 {
-	int temp; 
+	uint32_t temp;
 	temp = array[x];
 	array[x] = array[y];
 	array[y] = temp;
 	return;
 }
 
-void createRoomFile(struct room r, int roomNumber) /* This function writes the room files that are used by the program. */
+char *roomName(struct world *w, uint32_t room) /* The name of a room is where its nameStart points in the pool of names. */
 {
-	FILE *filePointer; /* Holds a pointer to the file. */
-	int i; /* Standard loop control variable. */
-	char roomName[2]; /* Holds a single digit number plus null terminator. */
-	sprintf(roomName, "%d", roomNumber); /* Takes the room number passed in by the parameter and converts it into a string, then stores the result in the roomName char array. */
-	
-	filePointer = fopen(roomName, "w"); /* Creates a file name */
-	if (filePointer == NULL) /* filePointer will be null in the case of an error. */
+	return w->names + w->nameStart[room];
+}
+
+/* The numberOfConnections function returns how many connections a room has. The connections of a room run up to where the next
+ * room's begin, except while the connections are being generated, when connectionCount says how many of its slots are filled in. */
+
+uint32_t numberOfConnections(struct world *w, uint32_t room)
+{
+	if (w->connectionCount != NULL)
 	{
-		perror("Error: could not create room file."); /* Creates error message if couldn't create file. */
-		exit(1); /* Exit with a code of 1. */
+		return w->connectionCount[room];
 	}
 
-	fprintf(filePointer, "ROOM NAME: %s\n", r.name); /* Access the passed in room structures name field and print that to the file. */
-	
-	for (i = 0; i < r.numberOfConnections; i++)
+	return w->connectionStart[room + 1] - w->connectionStart[room];
+}
+
+/* The findRoom function looks a name up in the name index, and returns the number of the room with that name, or NO_ROOM if there is
+ * none. It starts at the slot the hash of the name points at, and goes through the slots after it until it finds the room or an empty
+ * slot, which is usually right away. */
+
+uint32_t findRoom(struct world *w, char *name)
+{
+	uint32_t mask = w->indexSize - 1; /* The size is a power of two, so this wraps a slot number around. */
+	uint32_t slot; /* The slot being looked at. */
+
+	for (slot = hashName(name) & mask; w->nameIndex[slot] != NO_ROOM; slot = (slot + 1) & mask)
 	{
-		fprintf(filePointer, "CONNECTION %d: ", i + 1); /* For each connection, we are printing it to the file, but starting at i + 1 because 
-								 * we are starting at connection #1, but i starts at 0. */
-		if (roomsList[r.connections[i]].name == NULL) /* If there is no name for the connection, just continue on. */
+		if (strcmp(name, roomName(w, w->nameIndex[slot])) == 0)
 		{
-			continue;
+			return w->nameIndex[slot];
 		}
-		
-		fprintf(filePointer, "%s\n", roomsList[r.connections[i]].name); /* Print the name of the connection, then add a newline.*/
 	}
-	
-	fprintf(filePointer, "ROOM TYPE: %s\n", r.type); /* Print the room type of the room structure. */
-	fclose(filePointer); /* Close the file pointer. */
-	return;
+
+	return NO_ROOM;
+}
+
+uint32_t hashName(char *name) /* The FNV-1a hash of a name, which mixes in one character at a time. */
+{
+	uint32_t hash = 2166136261u;
+
+	while (*name != '\0')
+	{
+		hash = (hash ^ (unsigned char)*name++) * 16777619u;
+	}
+
+	return hash;
+}
+
+/* The nameIndexSize function returns how many slots the name index of a world with numberOfRooms rooms has, the smallest power of two
+ * that is at least half again as big as the number of rooms. */
+
+uint32_t nameIndexSize(uint32_t numberOfRooms)
+{
+	uint32_t size; /* Loop control variable. */
+
+	for (size = 2; size < numberOfRooms + numberOfRooms / 2; size *= 2)
+	{
+	}
+
+	return size;
 }
 
-void readType(struct room *r, int roomNumber) /* Reads the room type from the room file. */
+/* The buildNameIndex function makes the name index of a world that was just generated, putting every room in the first empty slot
+ * from where the hash of its name points. */
+
+void buildNameIndex(struct world *w)
 {
-	FILE *filePointer; /* creates file pointer. */
-	int i; /* standard loop control variable. */
-	char roomName[2]; /* Holds a single digit number plus null terminator. */
-	char readBuffer[100]; /* Holds what is read from the file for use by the main program. */
-	char *newline; /* Holds the location of the newlines in the strings so that they can be converted to null terminators. */
-	
-	sprintf(roomName, "%d", roomNumber);
-	filePointer = fopen(roomName, "r"); /* Opens the room file in read mode. */
-	if (filePointer == NULL)
+	uint32_t room; /* Loop control variable. */
+
+	w->indexSize = nameIndexSize(w->numberOfRooms);
+	w->nameIndex = malloc((size_t)w->indexSize * sizeof(uint32_t));
+
+	if (w->nameIndex == NULL)
 	{
-		perror("Error: could not read room file."); /* Creates error message if couldn't read room file. */
+		perror("Error: not enough memory for the name index.");
 		exit(1);
 	}
 
-	while (fgets(readBuffer, 100, filePointer) != NULL) /* While characters from the file can still be read into the buffer. */
-		if (strncmp(readBuffer, "ROOM NAME", 9) == 0) /* If Room name is found in the file. */
-		{
-			strcpy(r->name, readBuffer + 11); /* Skips ROOM NAME and reads the name of the room. */
-			newline = strchr(r->name, '\n');
-			*newline = '\0'; /* This line and the above one replace newline with a null character. */ 		
-		}
-		
-		else if (strncmp(readBuffer, "ROOM TYPE",9) == 0) /* Else if room type is found in the file. */
+	memset(w->nameIndex, 0xff, (size_t)w->indexSize * sizeof(uint32_t)); /* Every byte 0xff makes every slot NO_ROOM. */
+
+	for (room = 0; room < w->numberOfRooms; room++)
+	{
+		uint32_t slot = hashName(roomName(w, room)) & (w->indexSize - 1);
+
+		while (w->nameIndex[slot] != NO_ROOM)
 		{
-			strcpy(r->type, readBuffer + 11); /* Skips ROOM TYPE and reads the type of the room into the structure. */
-			newline = strchr(r->type, '\n');
-			*newline = '\0'; /* This line and the above one replace newline with a null character. */
+			slot = (slot + 1) & (w->indexSize - 1);
 		}
+
+		w->nameIndex[slot] = room;
+	}
 }
 
-void readConnections(struct room *r, int roomNumber) /* Reads the connections from a room file. */
+/* The generateNames function fills in the pool of names and the type of each room. With up to 10 rooms, I was trying to think of how
+ * I could uniquely assign names without re-using any. In a for loop, I decide to create a random number from 0 to 9, corresponding to
+ * the indexes of the roomNames array. With more rooms than names, the names are used in turn with a number after them, so room 25 is
+ * "Hayward City 3" or similar, which keeps every name different. The first room is the start room and the last room is the end room. */
+
+void generateNames(struct world *w, struct randomState *random)
 {
-	FILE *filePointer; /* Creates file pointer. */
-	int i; /* Standard loop control variable. */
-	int connectionIndex = 0; /* Holds the index of the read connection. */
-	int roomIndex; /* holds the room index for read connection names. */
-	char roomName[2]; /* Holds a single digit number plus null terminator. */
-	char readBuffer[100]; /* Holds what is read from the file for use by the main program. */
-	char *newline; /* Holds the location of the newlines in the strings so that they can be converted to null terminators. */
+	uint32_t i; /* Loop control variable. */
+	char *pool[NUMBER_OF_NAMES]; /* The names not used yet. It is a copy, so worlds generated at the same time don't shuffle the same one. */
+	size_t used = 0; /* How much of the pool has been filled. */
+	size_t capacity = (size_t)w->numberOfRooms * NAME_CAPACITY;
+
+	w->nameStart = malloc(((size_t)w->numberOfRooms + 1) * sizeof(uint32_t));
+	w->names = malloc(capacity);
+	w->types = malloc(w->numberOfRooms);
 
-	sprintf(roomName, "%d", roomNumber); 
-	filePointer = fopen(roomName, "r"); /* Opens room file in read mode. */
-	
-	if (filePointer == NULL)
+	if (w->nameStart == NULL || w->names == NULL || w->types == NULL)
 	{
-		perror("Error: could not read room file."); /* Creates error message if couldn't read room file. */
+		perror("Error: not enough memory for the rooms.");
 		exit(1);
 	}
 
-	while (fgets(readBuffer, 100, filePointer) != NULL) /* While characters from the file can still be read into the buffer. */ 
+	memcpy(pool, roomNames, sizeof(pool));
+
+	for (i = 0; i < w->numberOfRooms; i++) /* Perform this procedure to assign a name to each room. */
+	{
+		char *chosenName; /* create a variable to store the name that will eventually be chosen for the room. */
+
+		if (w->numberOfRooms <= NUMBER_OF_NAMES)
 		{
-			if (strncmp(readBuffer, "CONNECTION", 9) == 0) /* If connection is found as a string in the file. */
-			{
-				char connectionName[100]; /* Allocates space to hold the read connection string from the buffer. */
-				strcpy(connectionName, readBuffer + 14); /* Skips "CONNECTION: " */
-				newline = strchr(connectionName, '\n');
-				*newline = '\0'; /* Replaces the newline in the read string with the null terminator. */
+			int chosen = randomNumber(random, NUMBER_OF_NAMES - i);
 
-				for (i = 0; i < NUMBER_OF_ROOMS; i++)
-				{
-					if (strcmp(connectionName, roomsList[i].name) == 0) /* Searches each room's name structures for a string matching the name of the connection. */
-					{
-						roomIndex = i; /* If matching room found, set the roomIndex equal to the room that corresponds to the name of the connection. */
-					}
-				}
-				r->connections[connectionIndex] = roomIndex; /*Sets the connection of the room to the index corresponding to the room corresponding to the read name of the connection from the file. */
-				connectionIndex++; /* Increments connectionIndex by 1 in order to read and assign other connections from the file. */
-			}
+			swapStrings(pool, chosen, (NUMBER_OF_NAMES - i - 1)); /* Swap the element of the randomized number with numberOfNames - i - 1. This ensures
+											  * randomized names are not reused. */
+			chosenName = pool[NUMBER_OF_NAMES - i - 1]; /* After the above swapping, we store the chosen name into, well, the chosenName variable. */
+			w->nameStart[i] = used;
+			used += sprintf(w->names + used, "%s", chosenName) + 1; /* Copies the chosen name into the pool. */
+		}
+
+		else
+		{
+			w->nameStart[i] = used;
+			used += sprintf(w->names + used, "%s %u", roomNames[i % NUMBER_OF_NAMES], i / NUMBER_OF_NAMES + 1) + 1;
+		}
+
+		w->types[i] = MID_ROOM; /* Initially, we are setting the type of each room to MID_ROOM, and will manually change 2 of the rooms to START_ROOM and END_ROOM types. */
+	}
+
+	w->nameStart[w->numberOfRooms] = used;
+	w->names = realloc(w->names, used); /* Give back what the names did not need. */
+
+	w->startRoom = 0;
+	w->endRoom = w->numberOfRooms - 1;
+	w->types[w->startRoom] = START_ROOM; /* Set the first room in the list of rooms to have the START_ROOM type. */
+	w->types[w->endRoom] = END_ROOM; /* Set the final room in the list of rooms to have the END_ROOM type. */
+}
+
+/* The seedRandom function starts a random state from a seed, by filling it with four numbers from splitmix64, which never gives a
+ * state of all zeros, the one state xoshiro256** can't leave. */
+
+void seedRandom(struct randomState *random, uint64_t seed)
+{
+	int i; /* Loop control variable. */
+
+	for (i = 0; i < 4; i++)
+	{
+		uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		random->s[i] = z ^ (z >> 31);
+	}
+}
+
+uint64_t nextRandom(struct randomState *random) /* The next 64 bits of xoshiro256**. */
+{
+	uint64_t *s = random->s;
+	uint64_t result = s[1] * 5;
+	uint64_t t = s[1] << 17;
+
+	result = ((result << 7) | (result >> 57)) * 9;
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = (s[3] << 45) | (s[3] >> 19);
+	return result;
+}
+
+/* The randomNumber function returns a random number from 0 up to, but not including, bound. It draws from the random state of the
+ * world being generated instead of from rand(), so the same seed always gives the same world. Instead of dividing, it multiplies 32
+ * random bits by the bound and keeps the top half, and draws again in the rare case that would make some numbers more likely than
+ * others. */
+
+uint32_t randomNumber(struct randomState *random, uint32_t bound)
+{
+	uint64_t product = (nextRandom(random) >> 32) * bound;
+
+	if ((uint32_t)product < bound)
+	{
+		uint32_t threshold = -bound % bound; /* 2^32 mod bound. */
+
+		while ((uint32_t)product < threshold)
+		{
+			product = (nextRandom(random) >> 32) * bound;
 		}
+	}
+
+	return product >> 32;
+}
+
+/* The generateConnections function connects the rooms, so that every room ends up with between the minimum and maximum number of
+ * connections, every connection goes both ways, no room is connected to itself or twice to the same room, and the end room can always
+ * be reached. It takes time in proportion to the number of connections, as follows.
+ *
+ * First, every room is given a target number of connections, at random between the minimum and maximum. Every connection has two
+ * ends, so if the targets add up to an odd number, one of them is moved by one, or there would always be a room one short. The
+ * connections of a room are kept in maxConnections slots, starting at slotStart, so they can never overflow, and the slots are later
+ * packed together in place into connectionStart and connections.
+ *
+ * Then the rooms are put in a random order, starting with the start room and ending with the end room, and each room is connected to
+ * the next one. This path is what makes sure the end room can be reached, so it is never taken apart, and its connections are the
+ * first ones in each room's slots.
+ *
+ * Every connection a room still needs is a stub. The stubs are shuffled and paired off, and each pair becomes a connection, unless the
+ * two stubs belong to the same room or the rooms are already connected, in which case the pair is tried again in the next round.
+ *
+ * What is left over only matters for rooms that are still under the minimum. They are connected to random rooms that have free slots,
+ * and if no room is free, a connection between two other rooms is split up so that both of them can connect to the room instead.
+ * Returns 0, or -1 if some room could not be given enough connections, which leaves a world that can only be freed. */
+
+int generateConnections(struct world *w, uint32_t minConnections, uint32_t maxConnections, struct randomState *random)
+{
+	uint32_t n = w->numberOfRooms;
+	uint32_t *slotStart = malloc(((size_t)n + 1) * sizeof(uint32_t)); /* Where the slots of each room begin, and then where its connections begin. */
+	uint32_t *degree = calloc(n, sizeof(uint32_t)); /* How many connections each room has so far. */
+	uint32_t *target = malloc((size_t)n * sizeof(uint32_t)); /* How many connections each room is meant to have. */
+	uint32_t *order = malloc((size_t)n * sizeof(uint32_t)); /* The rooms in the order of the path, and later the stubs. */
+	uint32_t *stubs;
+	size_t numberOfStubs = 0;
+	uint32_t i, j; /* Loop control variables */
+	int round; /* Counts the rounds of pairing, and then of fixing rooms. */
+
+	uint64_t targetTotal = 0; /* What the targets add up to. */
+
+	if (slotStart == NULL || degree == NULL || target == NULL || order == NULL)
+	{
+		perror("Error: not enough memory for the connections.");
+		exit(1);
+	}
+
+	for (i = 0; i < n; i++) /* Pick the target of every room, which is at least what the path gives it. */
+	{
+		uint32_t lowest = (minConnections > pathConnections(w, i)) ? minConnections : pathConnections(w, i);
 
-	fclose(filePointer); /* Closes the file after use. */
+		target[i] = lowest + randomNumber(random, maxConnections - lowest + 1);
+		targetTotal += target[i];
+		slotStart[i] = i * maxConnections;
+	}
+
+	slotStart[n] = n * maxConnections;
+
+	for (i = n; targetTotal % 2 == 1 && i > 0; i--) /* Make the targets add up to an even number, by moving the last one that can move. */
+	{
+		uint32_t lowest = (minConnections > pathConnections(w, i - 1)) ? minConnections : pathConnections(w, i - 1);
+
+		if (target[i - 1] < maxConnections)
+		{
+			target[i - 1]++;
+			targetTotal++;
+		}
+
+		else if (target[i - 1] > lowest)
+		{
+			target[i - 1]--;
+			targetTotal--;
+		}
+	}
+
+	w->connections = malloc((size_t)slotStart[n] * sizeof(uint32_t));
+
+	if (w->connections == NULL)
+	{
+		perror("Error: not enough memory for the connections.");
+		exit(1);
+	}
+
+	w->connectionStart = slotStart; /* connected() and addConnection() use these while the slots are being filled. */
+	w->connectionCount = degree;
+	w->connectionTarget = target;
+
+	/* The path goes through the rooms in between in a random order, which is shuffled the same way the names are. */
+
+	for (i = 0; i < n; i++)
+	{
+		order[i] = i;
+	}
+
+	for (i = n - 2; i > 1; i--)
+	{
+		swapRooms(order, i, 1 + randomNumber(random, i));
+	}
+
+	for (i = 0; i + 1 < n; i++)
+	{
+		addConnection(w, order[i], order[i + 1]);
+	}
+
+	free(order);
+
+	for (i = 0; i < n; i++) /* Count the stubs, which is every free slot. */
+	{
+		numberOfStubs += target[i] - degree[i];
+	}
+
+	stubs = malloc((numberOfStubs + 1) * sizeof(uint32_t));
+
+	if (stubs == NULL)
+	{
+		perror("Error: not enough memory for the connections.");
+		exit(1);
+	}
+
+	numberOfStubs = 0;
+
+	for (i = 0; i < n; i++)
+	{
+		for (j = degree[i]; j < target[i]; j++)
+		{
+			stubs[numberOfStubs++] = i;
+		}
+	}
+
+	/* Pair the stubs off. The pairs that did not work are moved to the front of the array and tried again, for a few rounds, which is
+	   enough for all but a handful of them. */
+
+	for (round = 0; round < 8 && numberOfStubs > 1; round++)
+	{
+		size_t stub, leftOver = 0;
+
+		for (stub = numberOfStubs - 1; stub > 0; stub--)
+		{
+			swapRooms(stubs, stub, randomNumber(random, stub + 1));
+		}
+
+		for (stub = 0; stub + 1 < numberOfStubs; stub += 2)
+		{
+			uint32_t a = stubs[stub], b = stubs[stub + 1];
+
+			if (a != b && !connected(w, a, b))
+			{
+				addConnection(w, a, b);
+			}
+
+			else
+			{
+				stubs[leftOver++] = a;
+				stubs[leftOver++] = b;
+			}
+		}
+
+		numberOfStubs = leftOver;
+	}
+
+	free(stubs);
+
+	/* Fix the rooms that are still under the minimum. A room that gives up a connection here can fall under the minimum itself, so
+	   this goes over the rooms again until none are left, which almost always takes one round. */
+
+	for (round = 0; ; round++)
+	{
+		int fixed = 1; /* Stays 1 if every room is at the minimum. */
+
+		for (i = 0; i < n; i++)
+		{
+			while (degree[i] < minConnections)
+			{
+				fixed = 0;
+
+				if (round == 16 || fixRoom(w, i, random) == -1)
+				{
+					w->connectionCount = w->connectionTarget = NULL;
+					free(degree);
+					free(target);
+					return -1;
+				}
+			}
+		}
+
+		if (fixed)
+		{
+			break;
+		}
+	}
+
+	/* Pack the connections together. Each room's connections only move towards the front, and the rooms are done in order, so nothing
+	   is overwritten before it has been moved. slotStart then becomes connectionStart. */
+
+	uint32_t packed = 0; /* Where the connections of the next room go. */
+
+	for (i = 0; i < n; i++)
+	{
+		uint32_t slots = slotStart[i];
+
+		slotStart[i] = packed;
+		memmove(w->connections + packed, w->connections + slots, degree[i] * sizeof(uint32_t));
+		packed += degree[i];
+	}
+
+	slotStart[n] = packed;
+	w->connections = realloc(w->connections, ((size_t)packed + 1) * sizeof(uint32_t)); /* Give back the slots that were not used. */
+	w->connectionCount = w->connectionTarget = NULL;
+	free(degree);
+	free(target);
+	return 0;
+}
+
+/* The pathConnections function returns how many connections the path gives a room: one for the start and end rooms, which are the
+ * ends of the path, and two for every other room. */
+
+uint32_t pathConnections(struct world *w, uint32_t room)
+{
+	return (room == w->startRoom || room == w->endRoom) ? 1 : 2;
+}
+
+/* The connected function returns 1 if two rooms are connected, and 0 if they aren't. It only needs to look through the connections of
+ * one of them, so it picks the one with fewer. The game uses it to check a move, and the generator to keep from connecting two rooms
+ * twice. */
+
+int connected(struct world *w, uint32_t a, uint32_t b)
+{
+	uint32_t *connections; /* The connections of the room being looked through. */
+	uint32_t i; /* Loop control variable. */
+
+	if (numberOfConnections(w, b) < numberOfConnections(w, a))
+	{
+		uint32_t room = a; /* Look through b instead. */
+		a = b;
+		b = room;
+	}
+
+	connections = w->connections + w->connectionStart[a];
+
+	for (i = numberOfConnections(w, a); i > 0; i--)
+	{
+		if (connections[i - 1] == b)
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+void addConnection(struct world *w, uint32_t a, uint32_t b) /* Connects two rooms both ways, in the next free slot of each. */
+{
+	w->connections[w->connectionStart[a] + w->connectionCount[a]++] = b;
+	w->connections[w->connectionStart[b] + w->connectionCount[b]++] = a;
+}
+
+void removeConnection(struct world *w, uint32_t a, uint32_t b) /* Takes apart the connection between two rooms, which is never one of the path. */
+{
+	uint32_t *connections = w->connections + w->connectionStart[a];
+	uint32_t i; /* Loop control variable. */
+
+	for (i = pathConnections(w, a); connections[i] != b; i++) /* Find b, and then move a's last connection into its place. */
+	{
+	}
+
+	connections[i] = connections[--w->connectionCount[a]];
+
+	connections = w->connections + w->connectionStart[b];
+
+	for (i = pathConnections(w, b); connections[i] != a; i++) /* And the same for a in b's connections. */
+	{
+	}
+
+	connections[i] = connections[--w->connectionCount[b]];
+}
+
+/* The fixRoom function gives one more connection to a room that is under the minimum. It first tries a few random rooms with a free
+ * slot, then every room in turn, then every room that is under the maximum, and if there are none, it takes apart a connection between two rooms that aren't connected
+ * to this one and connects both of them to it. That may leave the second room one short, which the caller takes care of. In a small
+ * world every such connection can have one end that is already connected to this room, and then only the other end is connected to
+ * it, which leaves the room it was taken from one short instead. Returns 0, or -1 if nothing could be done. */
+
+int fixRoom(struct world *w, uint32_t room, struct randomState *random)
+{
+	uint32_t n = w->numberOfRooms;
+	uint32_t other; /* The room to connect to. */
+	uint32_t fallbackSplit = NO_ROOM, fallbackOther = NO_ROOM; /* A connection whose second room is already connected to this one. */
+	int attempt;
+
+	for (attempt = 0; attempt < 64; attempt++)
+	{
+		other = randomNumber(random, n);
+
+		if (other != room && hasFreeSlot(w, other) && !connected(w, room, other))
+		{
+			addConnection(w, room, other);
+			return 0;
+		}
+	}
+
+	for (other = 0; other < n; other++)
+	{
+		if (other != room && hasFreeSlot(w, other) && !connected(w, room, other))
+		{
+			addConnection(w, room, other);
+			return 0;
+		}
+	}
+
+	for (other = 0; other < n; other++) /* A room at its target can still go over it, up to the maximum. */
+	{
+		if (other != room && w->connectionCount[other] < w->connectionStart[other + 1] - w->connectionStart[other] && !connected(w, room, other))
+		{
+			addConnection(w, room, other);
+			return 0;
+		}
+	}
+
+	for (attempt = 0; attempt < 64 * 1024; attempt++)
+	{
+		uint32_t split = randomNumber(random, n); /* The room whose connection is taken apart. */
+		uint32_t first = pathConnections(w, split);
+
+		if (split == room || w->connectionCount[split] <= first || connected(w, room, split))
+		{
+			continue;
+		}
+
+		other = w->connections[w->connectionStart[split] + first + randomNumber(random, w->connectionCount[split] - first)];
+
+		if (other == room)
+		{
+			continue;
+		}
+
+		if (connected(w, room, other))
+		{
+			fallbackSplit = split; /* Only good for one connection, so keep looking for a better one. */
+			fallbackOther = other;
+			continue;
+		}
+
+		removeConnection(w, split, other);
+		addConnection(w, room, split);
+
+		if (hasFreeSlot(w, room))
+		{
+			addConnection(w, room, other);
+		}
+
+		return 0;
+	}
+
+	if (fallbackSplit != NO_ROOM)
+	{
+		removeConnection(w, fallbackSplit, fallbackOther);
+		addConnection(w, room, fallbackSplit);
+		return 0;
+	}
+
+	return -1;
+}
+
+int hasFreeSlot(struct world *w, uint32_t room) /* Returns 1 if a room has fewer connections than its target. */
+{
+	return w->connectionCount[room] < w->connectionTarget[room];
+}
+
+void createRoomFile(struct world *w, char *directoryName, uint32_t room) /* This function writes the text room files, for --text. */
+{
+	FILE *filePointer; /* Holds a pointer to the file. */
+	uint32_t i; /* Standard loop control variable. */
+	char roomFileName[128]; /* Holds the directory and the room number, which is also the name of its file, plus null terminator. */
+	sprintf(roomFileName, "%s/%u", directoryName, room + 1); /* Converts the room number, counting from 1, into a string, and stores the result in the roomFileName char array. */
+
+	filePointer = fopen(roomFileName, "w"); /* Creates a file name */
+	if (filePointer == NULL) /* filePointer will be null in the case of an error. */
+	{
+		perror("Error: could not create room file."); /* Creates error message if couldn't create file. */
+		exit(1); /* Exit with a code of 1. */
+	}
+
+	fprintf(filePointer, "ROOM NAME: %s\n", roomName(w, room)); /* Print the name of the room to the file. */
+
+	for (i = 0; i < numberOfConnections(w, room); i++)
+	{
+		fprintf(filePointer, "CONNECTION %u: ", i + 1); /* For each connection, we are printing it to the file, but starting at i + 1 because
+								 * we are starting at connection #1, but i starts at 0. */
+		fprintf(filePointer, "%s\n", roomName(w, w->connections[w->connectionStart[room] + i])); /* Print the name of the connection, then add a newline.*/
+	}
+
+	fprintf(filePointer, "ROOM TYPE: %s\n", typeNames[w->types[room]]); /* Print the room type of the room. */
+	fclose(filePointer); /* Close the file pointer. */
+	return;
+}
+
+/* The writeWorld function writes a world to a world file. The file is written under a temporary name and then renamed, so a world
+ * file is never seen half written. */
+
+void writeWorld(struct world *w, char *fileName)
+{
+	struct worldHeader header;
+	char temporaryName[4096]; /* Where the file is written before it is renamed. */
+	int filefd;
+
+	fillHeader(w, &header);
+	snprintf(temporaryName, sizeof(temporaryName), "%s.%d", fileName, (int)getpid());
+	filefd = open(temporaryName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if (filefd == -1)
+	{
+		perror("Error: could not create world file.");
+		exit(1);
+	}
+
+	if (writeSections(w, &header, filefd, 0) == -1 || close(filefd) == -1 || rename(temporaryName, fileName) == -1)
+	{
+		perror("Error: could not write world file.");
+		unlink(temporaryName);
+		exit(1);
+	}
+}
+
+/* The fillHeader function fills in the header of the world file of a world. */
+
+void fillHeader(struct world *w, struct worldHeader *header)
+{
+	memset(header, 0, sizeof(*header));
+	memcpy(header->magic, WORLD_MAGIC, sizeof(header->magic));
+	header->version = WORLD_VERSION;
+	header->byteOrder = WORLD_BYTE_ORDER;
+	header->numberOfRooms = w->numberOfRooms;
+	header->startRoom = w->startRoom;
+	header->endRoom = w->endRoom;
+	header->numberOfConnections = w->connectionStart[w->numberOfRooms];
+	header->namesSize = w->nameStart[w->numberOfRooms];
+	header->indexSize = w->indexSize;
+	header->seed = w->seed;
+	sectionOffsets(header);
+}
+
+/* The writeSections function writes the header and sections of a world file into a file, starting at base, which is 0 for a world
+ * file and somewhere further on in an archive. The sections go in the order of the header, each starting on a multiple of 8 bytes,
+ * and sectionOffsets works out where. Everything is written with pwrite(), which leaves zeros in the gaps, and lets the threads of a
+ * batch write their worlds into the same archive at the same time. Returns 0, or -1 if something could not be written. */
+
+int writeSections(struct world *w, struct worldHeader *header, int filefd, off_t base)
+{
+	void *sections[WORLD_SECTIONS]; /* What goes in each section, in order. */
+	int section; /* Loop control variable. */
+
+	sections[0] = w->connectionStart;
+	sections[1] = w->connections;
+	sections[2] = w->nameStart;
+	sections[3] = w->names;
+	sections[4] = w->types;
+	sections[5] = w->nameIndex;
+
+	if (pwrite(filefd, header, sizeof(*header), base) != (ssize_t)sizeof(*header))
+	{
+		return -1;
+	}
+
+	for (section = 0; section < WORLD_SECTIONS; section++)
+	{
+		char *data = sections[section];
+		uint64_t written = 0; /* A big section can take more than one pwrite(). */
+
+		while (written < header->sections[section].size)
+		{
+			ssize_t result = pwrite(filefd, data + written, header->sections[section].size - written, base + header->sections[section].offset + written);
+
+			if (result <= 0)
+			{
+				return -1;
+			}
+
+			written += result;
+		}
+	}
+
+	return 0;
+}
+
+/* The sectionOffsets function fills in the size and offset of every section of a header from the number of rooms, connections and the
+ * size of the names, and the size of the whole file after them. */
+
+void sectionOffsets(struct worldHeader *header)
+{
+	uint64_t sizes[WORLD_SECTIONS]; /* In the order the sections are in the file. */
+	uint64_t offset = sizeof(struct worldHeader);
+	int section; /* Loop control variable. */
+
+	sizes[0] = ((uint64_t)header->numberOfRooms + 1) * sizeof(uint32_t); /* connectionStart */
+	sizes[1] = (uint64_t)header->numberOfConnections * sizeof(uint32_t); /* connections */
+	sizes[2] = ((uint64_t)header->numberOfRooms + 1) * sizeof(uint32_t); /* nameStart */
+	sizes[3] = header->namesSize; /* names */
+	sizes[4] = header->numberOfRooms; /* types */
+	sizes[5] = (uint64_t)header->indexSize * sizeof(uint32_t); /* nameIndex */
+
+	for (section = 0; section < WORLD_SECTIONS; section++)
+	{
+		offset = (offset + 7) & ~(uint64_t)7;
+		header->sections[section].offset = offset;
+		header->sections[section].size = sizes[section];
+		offset += sizes[section];
+	}
+
+	header->fileSize = offset;
+}
+
+/* The loadWorld function maps a world file into memory and points the arrays of the world straight at its sections, so loading does
+ * not parse any of the rooms or copy them anywhere. The arrays are read once, to check that they only point inside the world, and
+ * otherwise used straight from the mapping. The file can also be an archive, and then the whole archive is mapped, and the world is the one at worldNumber
+ * in its table. Returns 0, or -1 after printing what is wrong. */
+
+int loadWorld(struct world *w, char *fileName, uint32_t worldNumber)
+{
+	char *mapping;
+	size_t size;
+
+	if (mapWorldFile(fileName, &mapping, &size) == -1)
+	{
+		return -1;
+	}
+
+	if (openWorld(w, fileName, mapping, size, worldNumber) == -1)
+	{
+		munmap(mapping, size);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* The mapWorldFile function maps a whole world file or archive, read only, and puts where and how big the mapping is in mapping and
+ * size. Returns 0, or -1 after printing what is wrong. */
+
+int mapWorldFile(char *fileName, char **mapping, size_t *size)
+{
+	struct stat fileStatus;
+	int filefd = open(fileName, O_RDONLY);
+
+	if (filefd == -1 || fstat(filefd, &fileStatus) == -1)
+	{
+		fprintf(stderr, "Error: could not open world file %s.\n", fileName);
+		return -1;
+	}
+
+	if ((size_t)fileStatus.st_size < sizeof(struct archiveHeader))
+	{
+		fprintf(stderr, "Error: %s is not a world file.\n", fileName);
+		close(filefd);
+		return -1;
+	}
+
+	*mapping = mmap(NULL, fileStatus.st_size, PROT_READ, MAP_SHARED, filefd, 0);
+	*size = fileStatus.st_size;
+	close(filefd); /* The mapping stays after the file is closed. */
+
+	if (*mapping == MAP_FAILED)
+	{
+		perror("Error: could not map world file.");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* The openWorld function points the arrays of a world at world worldNumber of a mapped file, which is the only world of a world
+ * file, or one from the table of an archive. The headers are checked: that it is a world file of this version and byte order, and
+ * that every section is where it should be, inside the file. Then checkSections makes sure the contents of the sections can be used
+ * without any more checks while playing or solving. Many worlds can point into the same mapping, like the worlds of an
+ * archive being served, and then the mapping is only unmapped once, by whatever mapped it. Returns 0, or -1 after printing what is
+ * wrong. */
+
+int openWorld(struct world *w, char *fileName, char *mapping, size_t mappingSize, uint32_t worldNumber)
+{
+	struct worldHeader expected; /* What the header should say about the sections, worked out from its counts. */
+	struct worldHeader *header;
+	uint64_t base = 0, size = mappingSize; /* Where the world file is in the mapping, and how big it is. */
+
+	if (memcmp(mapping, ARCHIVE_MAGIC, 8) == 0) /* Find the world in the table of the archive. */
+	{
+		struct archiveHeader *archive = (struct archiveHeader *)mapping;
+		struct archiveEntry *entry = (struct archiveEntry *)(mapping + sizeof(struct archiveHeader)) + worldNumber;
+
+		if (archive->version != ARCHIVE_VERSION || archive->byteOrder != WORLD_BYTE_ORDER || worldNumber >= archive->numberOfWorlds
+			|| sizeof(struct archiveHeader) + ((uint64_t)worldNumber + 1) * sizeof(struct archiveEntry) > size || entry->size == 0
+			|| entry->offset % 8 != 0 || entry->offset > size || entry->size > size - entry->offset)
+		{
+			fprintf(stderr, "Error: %s has no world %u, or it is damaged.\n", fileName, worldNumber);
+			return -1;
+		}
+
+		base = entry->offset;
+		size = entry->size;
+	}
+
+	else if (worldNumber != 0)
+	{
+		fprintf(stderr, "Error: %s is not an archive, so it only has world 0.\n", fileName);
+		return -1;
+	}
+
+	header = (struct worldHeader *)(mapping + base);
+
+	if (size < sizeof(struct worldHeader))
+	{
+		fprintf(stderr, "Error: %s is not a world file.\n", fileName);
+		return -1;
+	}
+
+	memcpy(&expected, header, sizeof(expected));
+	sectionOffsets(&expected);
+
+	if (memcmp(header->magic, WORLD_MAGIC, sizeof(header->magic)) != 0 || header->byteOrder != WORLD_BYTE_ORDER || header->version != WORLD_VERSION
+		|| memcmp(header->sections, expected.sections, sizeof(expected.sections)) != 0 || header->fileSize != expected.fileSize
+		|| size < header->fileSize || header->numberOfRooms < 2 || header->startRoom >= header->numberOfRooms
+		|| header->endRoom >= header->numberOfRooms || header->indexSize < header->numberOfRooms + 1 || (header->indexSize & (header->indexSize - 1)) != 0
+		|| header->namesSize == 0 || mapping[base + header->sections[3].offset + header->namesSize - 1] != '\0'
+		|| checkSections(header, mapping + base) == -1)
+	{
+		fprintf(stderr, "Error: %s is not a world file of version %d, or it is damaged.\n", fileName, WORLD_VERSION);
+		return -1;
+	}
+
+	w->numberOfRooms = header->numberOfRooms;
+	w->startRoom = header->startRoom;
+	w->endRoom = header->endRoom;
+	w->seed = header->seed;
+	w->connectionStart = (uint32_t *)(mapping + base + header->sections[0].offset);
+	w->connections = (uint32_t *)(mapping + base + header->sections[1].offset);
+	w->nameStart = (uint32_t *)(mapping + base + header->sections[2].offset);
+	w->names = mapping + base + header->sections[3].offset;
+	w->types = (uint8_t *)(mapping + base + header->sections[4].offset);
+	w->nameIndex = (uint32_t *)(mapping + base + header->sections[5].offset);
+	w->indexSize = header->indexSize;
+	w->connectionCount = w->connectionTarget = NULL;
+	w->mapping = mapping;
+	w->mappingSize = mappingSize;
+	return 0;
+}
+
+/* The checkSections function goes over the sections of a world file once, whose header has already been checked, and makes sure that
+ * what they hold stays inside the world: the connections of each room start where the last room's end and stop at the number of
+ * connections, every connection and every entry of the name index is a room, every name starts inside the names, and every type is
+ * one of the three. The name index also has to have an empty slot, or findRoom would go around it forever looking for a name that
+ * is not there. A damaged or made up file could otherwise make the game read outside the mapping. Returns 0, or -1 if anything is
+ * wrong. */
+
+int checkSections(struct worldHeader *header, char *start)
+{
+	uint32_t *connectionStart = (uint32_t *)(start + header->sections[0].offset);
+	uint32_t *connections = (uint32_t *)(start + header->sections[1].offset);
+	uint32_t *nameStart = (uint32_t *)(start + header->sections[2].offset);
+	uint8_t *types = (uint8_t *)(start + header->sections[4].offset);
+	uint32_t *nameIndex = (uint32_t *)(start + header->sections[5].offset);
+	uint32_t rooms = header->numberOfRooms;
+	uint32_t filled = 0; /* Slots of the name index that are not empty. */
+	uint64_t i; /* Loop control variable. */
+
+	if (connectionStart[0] != 0 || connectionStart[rooms] != header->numberOfConnections || nameStart[rooms] > header->namesSize)
+	{
+		return -1;
+	}
+
+	for (i = 0; i < rooms; i++)
+	{
+		if (connectionStart[i] > connectionStart[i + 1] || nameStart[i] >= header->namesSize || types[i] > MID_ROOM)
+		{
+			return -1;
+		}
+	}
+
+	for (i = 0; i < header->numberOfConnections; i++)
+	{
+		if (connections[i] >= rooms)
+		{
+			return -1;
+		}
+	}
+
+	for (i = 0; i < header->indexSize; i++)
+	{
+		if (nameIndex[i] != NO_ROOM)
+		{
+			if (nameIndex[i] >= rooms)
+			{
+				return -1;
+			}
+			filled++;
+		}
+	}
+
+	return (filled < header->indexSize) ? 0 : -1;
+}
+
+/* The freeWorld function gives back the memory of a world, which is either one mapping or the arrays it was generated in. */
+
+void freeWorld(struct world *w)
+{
+	if (w->mapping != NULL)
+	{
+		munmap(w->mapping, w->mappingSize);
+	}
+
+	else
+	{
+		free(w->connectionStart);
+		free(w->connections);
+		free(w->nameStart);
+		free(w->names);
+		free(w->types);
+		free(w->nameIndex);
+	}
+
+	memset(w, 0, sizeof(*w));
+}
+
+/* The playGame function plays a world, reading the name of the next room from input one line at a time, with getline() so a line can
+ * be any length. Played at the keyboard, it prints the current room and its connections before every move, like it always has. With
+ * --replay, the moves come from a file, nothing is printed until the end, and then only whether the end room was found, after how
+ * many steps, and how many moves were not understood. The path taken grows as needed, so there is no limit on the number of steps.
+ * Returns 0 if the end room was found, and 1 if the input ran out first. */
+
+int playGame(struct world *w, FILE *input, int interactive)
+{
+	uint32_t currentRoom = w->startRoom; /* Holds the index of the current room. */
+	uint32_t nextRoom; /* Holds the index of the next room. */
+	uint32_t *pathTaken = NULL; /* The rooms visited, which is made bigger whenever it fills up. */
+	size_t pathCapacity = 0;
+	size_t stepCount = 0; /* Will record how many steps are taken on the journey. */
+	unsigned long misunderstood = 0; /* How many moves were not understood. */
+	char *inputBuffer = NULL; /* Holds the line read by getline(), which makes it big enough. */
+	size_t inputCapacity = 0;
+	ssize_t length; /* Of the line that was read. */
+	size_t i; /* Loop control variable. */
+
+	for (;;)
+	{
+		if (interactive == 1)
+		{
+			uint32_t first = w->connectionStart[currentRoom]; /* Where the connections of the current room begin. */
+			uint32_t count = numberOfConnections(w, currentRoom);
+
+			printf("CURRENT LOCATION: %s\n", roomName(w, currentRoom)); /* Print current location then the current rooms name, and new line. */
+			printf("POSSIBLE CONNECTIONS: "); /* Write "POSSIBLE CONNECTIONS: */
+			for (i = 0; i < count; i++)
+			{
+				printf("%s", roomName(w, w->connections[first + i])); /* For each connection, write the name of the connection. */
+				if (i == count - 1) /* If it is the last connection, add a period, then a new line. */
+				{
+					printf(".\n");
+				}
+
+				else /* If it isn't the last connection, add a period, then a space. */
+				{
+					printf(", ");
+				}
+			}
+
+			printf("WHERE TO? >"); /* Prints the where to prompt, with the cursor right outside the arrow key. */
+			fflush(stdout); /* Flush the standard output to properly read the input from the user. */
+		}
+
+		length = getline(&inputBuffer, &inputCapacity, input); /* Read input from user. */
+
+		if (length == -1) /* The input ran out before the end room was found. */
+		{
+			if (interactive == 1)
+			{
+				printf("\n");
+			}
+
+			else
+			{
+				printf("DID NOT FIND THE END ROOM. TOOK %zu STEPS, %lu MOVES WERE NOT UNDERSTOOD.\n", stepCount, misunderstood);
+			}
+
+			free(inputBuffer);
+			free(pathTaken);
+			return 1;
+		}
+
+		if (length > 0 && inputBuffer[length - 1] == '\n')
+		{
+			inputBuffer[length - 1] = '\0'; /* Replace newline from read string with null terminator. */
+		}
+
+		if (interactive == 1)
+		{
+			printf("\n"); /* Print new line anyway to space out the text. */
+		}
+
+		nextRoom = findRoom(w, inputBuffer); /* Looks the name up in the name index. */
+
+		if (nextRoom != NO_ROOM && !connected(w, currentRoom, nextRoom))
+		{
+			nextRoom = NO_ROOM; /* A room that isn't connected to the current room is just as invalid as one that doesn't exist. */
+		}
+
+		if (nextRoom == NO_ROOM)
+		{
+			if (interactive == 1)
+			{
+				printf("HUH? I DON'T UNDERSTAND THAT ROOM. TRY AGAIN.\n\n");
+			}
+			misunderstood++;
+			continue;
+		}
+
+		if (stepCount == pathCapacity) /* Double the path when it is full. */
+		{
+			pathCapacity = (pathCapacity == 0) ? 64 : pathCapacity * 2;
+			pathTaken = realloc(pathTaken, pathCapacity * sizeof(uint32_t));
+
+			if (pathTaken == NULL)
+			{
+				perror("Error: not enough memory for the path.");
+				exit(1);
+			}
+		}
+
+		currentRoom = nextRoom;
+		pathTaken[stepCount] = currentRoom;
+		stepCount++;
+
+		if (currentRoom == w->endRoom)
+		{
+			if (interactive == 1)
+			{
+				printf("YOU HAVE FOUND THE END ROOM. CONGRATULATIONS!\n");
+				printf("YOU TOOK %zu STEPS. YOUR PATH TO VICTORY WAS:\n", stepCount);
+
+				for (i = 0; i < stepCount; i++)
+				{
+					printf("%s\n", roomName(w, pathTaken[i]));
+				}
+			}
+
+			else
+			{
+				printf("FOUND THE END ROOM. TOOK %zu STEPS, %lu MOVES WERE NOT UNDERSTOOD.\n", stepCount, misunderstood);
+			}
+
+			free(inputBuffer);
+			free(pathTaken);
+			return 0;
+		}
+	}
+}
+
+/* The shortestPath function finds the fewest steps from the start room to the end room, with a breadth first search from both ends at
+ * once. Each turn, the side with the smaller frontier is taken one step further, and the search stops at the end of a step in which
+ * the two sides met, with the shortest of the paths through the rooms where they met. On a world of millions of rooms, each side only
+ * has to get about halfway, which visits far fewer rooms than a search from one end. The rooms of the path after the start room go in
+ * path, which needs room for numberOfRooms - 1 of them, if it isn't NULL. Returns the number of steps, or NO_ROOM if the end room
+ * cannot be reached. */
+
+uint32_t shortestPath(struct world *w, uint32_t *path)
+{
+	uint32_t n = w->numberOfRooms;
+	uint32_t *distance[2]; /* The distance of every room from the start room, and from the end room, or NO_ROOM if not reached yet. */
+	uint32_t *queue[2]; /* The rooms each side has reached, in order, of which the ones from head on are its frontier. */
+	size_t head[2] = {0, 0}, tail[2] = {1, 1};
+	uint32_t best = NO_ROOM, meeting = NO_ROOM; /* The length of the shortest path found, and the room where the two sides met on it. */
+	uint32_t room, step; /* Loop control variables. */
+	int side;
+
+	distance[0] = malloc((size_t)n * sizeof(uint32_t));
+	distance[1] = malloc((size_t)n * sizeof(uint32_t));
+	queue[0] = malloc((size_t)n * sizeof(uint32_t));
+	queue[1] = malloc((size_t)n * sizeof(uint32_t));
+
+	if (distance[0] == NULL || distance[1] == NULL || queue[0] == NULL || queue[1] == NULL)
+	{
+		perror("Error: not enough memory to solve the world.");
+		exit(1);
+	}
+
+	memset(distance[0], 0xff, (size_t)n * sizeof(uint32_t));
+	memset(distance[1], 0xff, (size_t)n * sizeof(uint32_t));
+	queue[0][0] = w->startRoom;
+	queue[1][0] = w->endRoom;
+	distance[0][w->startRoom] = 0;
+	distance[1][w->endRoom] = 0;
+
+	while (best == NO_ROOM && head[0] < tail[0] && head[1] < tail[1])
+	{
+		size_t levelEnd; /* Where the frontier ends, and the rooms found in this step begin. */
+
+		side = (tail[0] - head[0] <= tail[1] - head[1]) ? 0 : 1;
+
+		for (levelEnd = tail[side]; head[side] < levelEnd; head[side]++)
+		{
+			uint32_t from = queue[side][head[side]];
+			uint32_t connection;
+
+			for (connection = w->connectionStart[from]; connection < w->connectionStart[from + 1]; connection++)
+			{
+				uint32_t to = w->connections[connection];
+
+				if (distance[side][to] != NO_ROOM)
+				{
+					continue;
+				}
+
+				distance[side][to] = distance[side][from] + 1;
+				queue[side][tail[side]++] = to;
+
+				if (distance[!side][to] != NO_ROOM && distance[side][to] + distance[!side][to] < best)
+				{
+					best = distance[side][to] + distance[!side][to];
+					meeting = to;
+				}
+			}
+		}
+	}
+
+	/* Put the path together from where the sides met, going back to the start room and on to the end room through rooms that are one
+	   step closer each time. */
+
+	if (best != NO_ROOM && path != NULL)
+	{
+		for (side = 0; side < 2; side++)
+		{
+			room = meeting;
+
+			for (step = distance[side][meeting]; step > 0; step--)
+			{
+				uint32_t connection = w->connectionStart[room];
+
+				if (side == 0) /* Going back, the room is written before moving on, which leaves out the start room. */
+				{
+					path[step - 1] = room;
+				}
+
+				while (distance[side][w->connections[connection]] != step - 1)
+				{
+					connection++;
+				}
+
+				room = w->connections[connection];
+
+				if (side == 1) /* Going on, the room is written after moving to it, which leaves out the room where the sides met. */
+				{
+					path[best - step] = room;
+				}
+			}
+		}
+	}
+
+	free(distance[0]);
+	free(distance[1]);
+	free(queue[0]);
+	free(queue[1]);
+	return best;
+}
+
+/* The eccentricity function does a breadth first search from a room, and returns the distance to the room farthest from it, which it
+ * puts in farthest. distance and queue need room for every room. */
+
+uint32_t eccentricity(struct world *w, uint32_t from, uint32_t *distance, uint32_t *queue, uint32_t *farthest)
+{
+	size_t head = 0, tail = 1;
+
+	memset(distance, 0xff, (size_t)w->numberOfRooms * sizeof(uint32_t));
+	distance[from] = 0;
+	queue[0] = from;
+
+	while (head < tail)
+	{
+		uint32_t room = queue[head++];
+		uint32_t connection;
+
+		for (connection = w->connectionStart[room]; connection < w->connectionStart[room + 1]; connection++)
+		{
+			uint32_t to = w->connections[connection];
+
+			if (distance[to] == NO_ROOM)
+			{
+				distance[to] = distance[room] + 1;
+				queue[tail++] = to;
+			}
+		}
+	}
+
+	*farthest = queue[tail - 1]; /* The last room reached is as far as any. */
+	return distance[*farthest];
+}
+
+/* The diameter function returns the greatest number of steps between any two rooms. That takes a search from every room, which is only
+ * done for worlds of up to EXACT_DIAMETER_ROOMS rooms. Bigger worlds get the double sweep instead: a search from the start room finds
+ * the room farthest from it, and a search from that room gives a distance that is the diameter or a little less. exact says which. */
+
+uint32_t diameter(struct world *w, int *exact)
+{
+	uint32_t *distance = malloc((size_t)w->numberOfRooms * sizeof(uint32_t));
+	uint32_t *queue = malloc((size_t)w->numberOfRooms * sizeof(uint32_t));
+	uint32_t farthest, longest = 0, room;
+
+	if (distance == NULL || queue == NULL)
+	{
+		perror("Error: not enough memory to solve the world.");
+		exit(1);
+	}
+
+	*exact = (w->numberOfRooms <= EXACT_DIAMETER_ROOMS);
+
+	if (*exact)
+	{
+		for (room = 0; room < w->numberOfRooms; room++)
+		{
+			uint32_t distanceFromRoom = eccentricity(w, room, distance, queue, &farthest);
+
+			if (distanceFromRoom > longest)
+			{
+				longest = distanceFromRoom;
+			}
+		}
+	}
+
+	else
+	{
+		eccentricity(w, w->startRoom, distance, queue, &farthest);
+		longest = eccentricity(w, farthest, distance, queue, &farthest);
+	}
+
+	free(distance);
+	free(queue);
+	return longest;
+}
+
+double secondsSince(struct timespec *start) /* Returns the seconds since start, on the monotonic clock. */
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* The solveWorld function prints the shortest path through a world, its diameter, and how long each took to work out. Returns 0, or 1
+ * if the end room cannot be reached. */
+
+int solveWorld(struct world *w)
+{
+	uint32_t *path = malloc((size_t)w->numberOfRooms * sizeof(uint32_t));
+	struct timespec started;
+	double pathSeconds, diameterSeconds;
+	uint32_t steps, longest, i;
+	int exact;
+
+	if (path == NULL)
+	{
+		perror("Error: not enough memory to solve the world.");
+		exit(1);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &started);
+	steps = shortestPath(w, path);
+	pathSeconds = secondsSince(&started);
+
+	if (steps == NO_ROOM)
+	{
+		printf("THE END ROOM CANNOT BE REACHED FROM %s.\n", roomName(w, w->startRoom));
+		free(path);
+		return 1;
+	}
+
+	printf("SHORTEST PATH FROM %s TO %s: %u STEPS\n", roomName(w, w->startRoom), roomName(w, w->endRoom), steps);
+
+	for (i = 0; i < steps; i++)
+	{
+		printf("%s\n", roomName(w, path[i]));
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &started);
+	longest = diameter(w, &exact);
+	diameterSeconds = secondsSince(&started);
+
+	printf("DIAMETER: %s%u STEPS\n", exact ? "" : "AT LEAST ", longest);
+	printf("SOLVED IN %.6f SECONDS, DIAMETER IN %.6f SECONDS\n", pathSeconds, diameterSeconds);
+	printf("GENERATED FROM SEED %llu\n", (unsigned long long)w->seed);
+	free(path);
+	return 0;
+}
+
+/* The runBatch function generates --batch worlds from the options, with the seeds counting up from --seed, on --threads threads.
+ * Every world is checked with validateWorld and solved, and at the end the shortest paths and diameters are summed up, with how long
+ * it all took. Each world only depends on its own seed, so the same worlds come out on any number of threads. With --archive, the
+ * worlds that pass are written into one archive file, instead of one directory per world. Any world that fails is printed with its
+ * seed, so it can be generated again. Returns 0, or 1 if any world failed. */
+
+int runBatch(struct options *options)
+{
+	struct batch batch;
+	struct batchWorker *workers = calloc(options->threads, sizeof(struct batchWorker));
+	struct batchWorker total; /* All the workers added together. */
+	struct timespec started;
+	double seconds;
+	char temporaryName[4096];
+	uint64_t archiveEnd = 0; /* Where the archive ends, after the last world that was written. */
+	uint32_t thread; /* Loop control variable. */
+
+	if (workers == NULL)
+	{
+		perror("Error: not enough memory for the threads.");
+		exit(1);
+	}
+
+	memset(&batch, 0, sizeof(batch));
+	batch.options = options;
+	batch.archivefd = -1;
+	pthread_mutex_init(&batch.lock, NULL);
+
+	if (options->archiveFile != NULL) /* The worlds go after the archive header and the table of where each one is. */
+	{
+		snprintf(temporaryName, sizeof(temporaryName), "%s.%d", options->archiveFile, (int)getpid());
+		batch.archivefd = open(temporaryName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		batch.entries = calloc(options->batch, sizeof(struct archiveEntry));
+		batch.firstWorld = (sizeof(struct archiveHeader) + (uint64_t)options->batch * sizeof(struct archiveEntry) + 7) & ~(uint64_t)7;
+
+		if (batch.archivefd == -1 || batch.entries == NULL)
+		{
+			perror("Error: could not create archive file.");
+			exit(1);
+		}
+
+		/* The biggest world has every room at the most connections and the longest names, and its file size is the space for each world. */
+
+		struct worldHeader biggest;
+
+		memset(&biggest, 0, sizeof(biggest));
+		biggest.numberOfRooms = options->numberOfRooms;
+		biggest.numberOfConnections = options->numberOfRooms * options->maxConnections; /* Fits, since the options were checked for that. */
+		biggest.namesSize = (uint64_t)options->numberOfRooms * NAME_CAPACITY;
+		biggest.indexSize = nameIndexSize(options->numberOfRooms);
+		sectionOffsets(&biggest);
+		batch.worldSpace = (biggest.fileSize + 7) & ~(uint64_t)7;
+
+		if (batch.worldSpace > ((uint64_t)INT64_MAX - batch.firstWorld) / options->batch)
+		{
+			fprintf(stderr, "Error: an archive of %u worlds of %u rooms would be too big.\n", options->batch, options->numberOfRooms);
+			unlink(temporaryName);
+			exit(1);
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &started);
+
+	for (thread = 0; thread < options->threads; thread++)
+	{
+		workers[thread].batch = &batch;
+
+		if (pthread_create(&workers[thread].thread, NULL, batchWorker, &workers[thread]) != 0)
+		{
+			perror("Error: could not start a thread.");
+			exit(1);
+		}
+	}
+
+	memset(&total, 0, sizeof(total));
+	total.minimumSteps = total.minimumDiameter = NO_ROOM;
+	total.exact = 1;
+
+	for (thread = 0; thread < options->threads; thread++)
+	{
+		struct batchWorker *worker = &workers[thread];
+
+		pthread_join(worker->thread, NULL);
+		total.generateSeconds += worker->generateSeconds;
+		total.solveSeconds += worker->solveSeconds;
+		total.solved += worker->solved;
+		total.failed += worker->failed;
+		total.totalSteps += worker->totalSteps;
+		total.totalDiameter += worker->totalDiameter;
+		total.minimumSteps = (worker->minimumSteps < total.minimumSteps) ? worker->minimumSteps : total.minimumSteps;
+		total.maximumSteps = (worker->maximumSteps > total.maximumSteps) ? worker->maximumSteps : total.maximumSteps;
+		total.minimumDiameter = (worker->minimumDiameter < total.minimumDiameter) ? worker->minimumDiameter : total.minimumDiameter;
+		total.maximumDiameter = (worker->maximumDiameter > total.maximumDiameter) ? worker->maximumDiameter : total.maximumDiameter;
+		total.exact &= (worker->solved == 0 || worker->exact);
+		total.writeFailed |= worker->writeFailed;
+	}
+
+	if (batch.archivefd != -1) /* The header and the table go in last, once every world has been written. */
+	{
+		struct archiveHeader header;
+		size_t tableSize = (size_t)options->batch * sizeof(struct archiveEntry);
+		uint32_t world; /* Loop control variable. */
+
+		archiveEnd = batch.firstWorld; /* The archive ends after the last world that was written. */
+
+		for (world = 0; world < options->batch; world++)
+		{
+			if (batch.entries[world].size > 0)
+			{
+				archiveEnd = (batch.entries[world].offset + batch.entries[world].size + 7) & ~(uint64_t)7;
+			}
+		}
+
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, ARCHIVE_MAGIC, sizeof(header.magic));
+		header.version = ARCHIVE_VERSION;
+		header.byteOrder = WORLD_BYTE_ORDER;
+		header.numberOfWorlds = options->batch;
+
+		if (pwrite(batch.archivefd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)
+			|| pwrite(batch.archivefd, batch.entries, tableSize, sizeof(header)) != (ssize_t)tableSize || total.writeFailed
+			|| ftruncate(batch.archivefd, archiveEnd) == -1 || close(batch.archivefd) == -1 || rename(temporaryName, options->archiveFile) == -1)
+		{
+			perror("Error: could not write archive file.");
+			unlink(temporaryName);
+			exit(1);
+		}
+
+		free(batch.entries);
+	}
+
+	seconds = secondsSince(&started);
+	pthread_mutex_destroy(&batch.lock);
+	free(workers);
+
+	printf("%u WORLDS OF %u ROOMS, SEEDS %llu TO %llu, %u FAILED\n", options->batch, options->numberOfRooms, (unsigned long long)options->seed,
+		(unsigned long long)(options->seed + options->batch - 1), total.failed);
+
+	if (total.solved > 0)
+	{
+		printf("SHORTEST PATH: %u TO %u STEPS, %.2f ON AVERAGE\n", total.minimumSteps, total.maximumSteps, total.totalSteps / total.solved);
+		printf("DIAMETER%s: %u TO %u STEPS, %.2f ON AVERAGE\n", total.exact ? "" : " (AT LEAST)", total.minimumDiameter, total.maximumDiameter,
+			total.totalDiameter / total.solved);
+	}
+
+	printf("%.3f SECONDS ON %u THREADS, %.0f WORLDS PER SECOND. THE THREADS SPENT %.3f SECONDS GENERATING AND %.3f SOLVING\n", seconds,
+		options->threads, options->batch / seconds, total.generateSeconds, total.solveSeconds);
+
+	if (options->archiveFile != NULL)
+	{
+		printf("%u WORLDS WRITTEN TO %s, %llu BYTES\n", total.solved, options->archiveFile, (unsigned long long)archiveEnd);
+	}
+
+	return total.failed > 0;
+}
+
+/* The batchWorker function is what each thread of runBatch runs. It takes BATCH_CHUNK worlds at a time from the ones left, so the
+ * threads seldom wait for the lock, and generates, checks and solves them, keeping its own totals so that nothing else is shared.
+ * A world for the archive is written with pwrite() at the place that its number sets aside for it, so the threads write at the same
+ * time without the lock, and the archive comes out the same byte for byte on any number of threads. */
+
+void *batchWorker(void *argument)
+{
+	struct batchWorker *worker = argument;
+	struct batch *batch = worker->batch;
+	struct options *options = batch->options;
+	struct world world;
+	struct timespec started;
+	uint32_t first, last, worldNumber;
+
+	worker->minimumSteps = worker->minimumDiameter = NO_ROOM;
+	worker->exact = 1;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&batch->lock);
+		first = batch->nextWorld;
+		last = (options->batch - first > BATCH_CHUNK) ? first + BATCH_CHUNK : options->batch;
+		batch->nextWorld = last;
+		pthread_mutex_unlock(&batch->lock);
+
+		if (first == last)
+		{
+			return NULL;
+		}
+
+		for (worldNumber = first; worldNumber < last; worldNumber++)
+		{
+			struct randomState random;
+			const char *problem;
+			uint32_t steps, longest;
+			int generated, exact;
+
+			clock_gettime(CLOCK_MONOTONIC, &started);
+			memset(&world, 0, sizeof(world));
+			world.numberOfRooms = options->numberOfRooms;
+			world.seed = options->seed + worldNumber; /* Every world has its own stream of random numbers, whichever thread makes it. */
+			seedRandom(&random, world.seed);
+			generateNames(&world, &random);
+			generated = generateConnections(&world, options->minConnections, options->maxConnections, &random);
+			worker->generateSeconds += secondsSince(&started);
+
+			if (generated == -1)
+			{
+				printf("SEED %llu: COULD NOT GIVE EVERY ROOM BETWEEN %u AND %u CONNECTIONS.\n", (unsigned long long)world.seed, options->minConnections, options->maxConnections);
+				worker->failed++;
+				freeWorld(&world);
+				continue;
+			}
+
+			clock_gettime(CLOCK_MONOTONIC, &started);
+			problem = validateWorld(&world, options->minConnections, options->maxConnections);
+			steps = shortestPath(&world, NULL);
+			longest = diameter(&world, &exact);
+			worker->solveSeconds += secondsSince(&started);
+
+			if (problem != NULL)
+			{
+				printf("SEED %llu: %s.\n", (unsigned long long)world.seed, problem);
+				worker->failed++;
+				freeWorld(&world);
+				continue;
+			}
+
+			worker->solved++;
+			worker->minimumSteps = (steps < worker->minimumSteps) ? steps : worker->minimumSteps;
+			worker->maximumSteps = (steps > worker->maximumSteps) ? steps : worker->maximumSteps;
+			worker->totalSteps += steps;
+			worker->minimumDiameter = (longest < worker->minimumDiameter) ? longest : worker->minimumDiameter;
+			worker->maximumDiameter = (longest > worker->maximumDiameter) ? longest : worker->maximumDiameter;
+			worker->totalDiameter += longest;
+			worker->exact &= exact;
+
+			if (batch->archivefd != -1)
+			{
+				struct worldHeader header;
+				struct archiveEntry *entry = &batch->entries[worldNumber];
+
+				buildNameIndex(&world); /* The worlds in an archive can be played, so they need their name index. */
+				fillHeader(&world, &header);
+
+				entry->offset = batch->firstWorld + (uint64_t)worldNumber * batch->worldSpace;
+				entry->size = header.fileSize;
+				entry->seed = world.seed;
+
+				if (header.fileSize > batch->worldSpace || writeSections(&world, &header, batch->archivefd, entry->offset) == -1)
+				{
+					worker->writeFailed = 1;
+				}
+			}
+
+			freeWorld(&world);
+		}
+	}
+}
+
+/* The validateWorld function checks everything the generator promises about a world: every room has between the minimum and maximum
+ * number of connections, no room is connected to itself or twice to the same room, every connection goes both ways, and every room,
+ * so the end room too, can be reached from the start room. Returns NULL if the world is right, or what is wrong with it. */
+
+const char *validateWorld(struct world *w, uint32_t minConnections, uint32_t maxConnections)
+{
+	uint32_t *distance = malloc((size_t)w->numberOfRooms * sizeof(uint32_t));
+	uint32_t *queue = malloc((size_t)w->numberOfRooms * sizeof(uint32_t));
+	const char *problem = NULL;
+	uint32_t room, farthest, connection, other; /* Loop control variables. */
+
+	if (distance == NULL || queue == NULL)
+	{
+		perror("Error: not enough memory to check the world.");
+		exit(1);
+	}
+
+	for (room = 0; room < w->numberOfRooms && problem == NULL; room++)
+	{
+		uint32_t first = w->connectionStart[room];
+
+		if (numberOfConnections(w, room) < minConnections || numberOfConnections(w, room) > maxConnections)
+		{
+			problem = "A ROOM HAS TOO FEW OR TOO MANY CONNECTIONS";
+		}
+
+		for (connection = first; connection < w->connectionStart[room + 1] && problem == NULL; connection++)
+		{
+			uint32_t to = w->connections[connection];
+
+			if (to >= w->numberOfRooms || to == room)
+			{
+				problem = "A ROOM IS CONNECTED TO ITSELF OR TO A ROOM THAT DOES NOT EXIST";
+			}
+
+			else if (!connected(w, to, room))
+			{
+				problem = "A CONNECTION ONLY GOES ONE WAY";
+			}
+
+			for (other = first; other < connection && problem == NULL; other++)
+			{
+				if (w->connections[other] == to)
+				{
+					problem = "TWO ROOMS ARE CONNECTED TWICE";
+				}
+			}
+		}
+	}
+
+	if (problem == NULL)
+	{
+		eccentricity(w, w->startRoom, distance, queue, &farthest);
+
+		for (room = 0; room < w->numberOfRooms && problem == NULL; room++)
+		{
+			if (distance[room] == NO_ROOM)
+			{
+				problem = (room == w->endRoom) ? "THE END ROOM CANNOT BE REACHED" : "A ROOM CANNOT BE REACHED";
+			}
+		}
+	}
+
+	free(distance);
+	free(queue);
+	return problem;
+}
+
+/* The runServer function serves the world file or archive from --load to players over sockets, with --serve followed by either a
+ * port number, for TCP, or the path of a Unix socket. The file is mapped once, and every session plays from that one read only
+ * mapping: a world file is shared by every player, and with an archive each new session gets the next world of it. One thread waits
+ * on epoll for every socket at once, and each session only keeps where its player is, the path they took, and a line that is still
+ * coming in, so thousands of players fit in one process. Output that a player is not reading yet is kept until the socket can take
+ * it, and nothing more is read from them until then. Only returns if the server could not be started, with 1. */
+
+int runServer(struct options *options)
+{
+	struct server server;
+	struct epoll_event events[SERVER_EVENTS];
+	size_t size;
+	int count, event; /* Loop control variable. */
+
+	memset(&server, 0, sizeof(server));
+
+	if (mapWorldFile(options->loadFile, &server.mapping, &size) == -1)
+	{
+		return 1;
+	}
+
+	server.fileName = options->loadFile;
+	server.mappingSize = size;
+	server.numberOfWorlds = (memcmp(server.mapping, ARCHIVE_MAGIC, 8) == 0) ? ((struct archiveHeader *)server.mapping)->numberOfWorlds : 1;
+	server.worlds = calloc(server.numberOfWorlds, sizeof(struct world)); /* Each one is filled in when a session first gets it. */
+
+	if (server.worlds == NULL || server.numberOfWorlds == 0)
+	{
+		fprintf(stderr, "Error: %s has no worlds to serve.\n", options->loadFile);
+		return 1;
+	}
+
+	signal(SIGPIPE, SIG_IGN); /* A player who leaves while being written to is noticed by write() instead. */
+
+	server.listenfd = listenOn(options->serveAddress);
+	server.epollfd = epoll_create1(0);
+
+	if (server.listenfd == -1 || server.epollfd == -1)
+	{
+		perror("Error: could not start the server.");
+		return 1;
+	}
+
+	watchListener(&server, 1);
+	printf("SERVING %u WORLD%s FROM %s ON %s\n", server.numberOfWorlds, server.numberOfWorlds == 1 ? "" : "S", options->loadFile, options->serveAddress);
+	fflush(stdout);
+
+	for (;;)
+	{
+		count = epoll_wait(server.epollfd, events, SERVER_EVENTS, -1);
+
+		for (event = 0; event < count; event++)
+		{
+			struct session *session;
+
+			if (events[event].data.fd == server.listenfd)
+			{
+				acceptSessions(&server);
+				continue;
+			}
+
+			session = server.sessions[events[event].data.fd];
+
+			if (session == NULL) /* It was closed by an earlier event. */
+			{
+				continue;
+			}
+
+			if (events[event].events & (EPOLLERR | EPOLLHUP) && !(events[event].events & EPOLLIN))
+			{
+				closeSession(&server, session);
+			}
+
+			else if (events[event].events & EPOLLOUT)
+			{
+				flushSession(&server, session);
+			}
+
+			else if (events[event].events & EPOLLIN)
+			{
+				readSession(&server, session);
+			}
+		}
+	}
+}
+
+/* The listenOn function makes a listening socket for an address, which is a TCP port if it is all digits, and otherwise the path of
+ * a Unix socket, which is removed first if it is left over from before. Returns the socket, or -1. */
+
+int listenOn(char *address)
+{
+	int listenfd, on = 1;
+
+	if (strspn(address, "0123456789") == strlen(address))
+	{
+		struct sockaddr_in serverAddress;
+
+		memset(&serverAddress, 0, sizeof(serverAddress));
+		serverAddress.sin_family = AF_INET;
+		serverAddress.sin_port = htons(atoi(address));
+		serverAddress.sin_addr.s_addr = INADDR_ANY;
+		listenfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+		if (listenfd == -1 || setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) == -1
+			|| bind(listenfd, (struct sockaddr *)&serverAddress, sizeof(serverAddress)) == -1)
+		{
+			return -1;
+		}
+	}
+
+	else
+	{
+		struct sockaddr_un serverAddress;
+
+		memset(&serverAddress, 0, sizeof(serverAddress));
+		serverAddress.sun_family = AF_UNIX;
+		snprintf(serverAddress.sun_path, sizeof(serverAddress.sun_path), "%s", address);
+		unlink(address);
+		listenfd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+		if (listenfd == -1 || bind(listenfd, (struct sockaddr *)&serverAddress, sizeof(serverAddress)) == -1)
+		{
+			return -1;
+		}
+	}
+
+	return (listen(listenfd, SOMAXCONN) == -1) ? -1 : listenfd;
+}
+
+/* The watchListener function starts or stops waiting for new players. It stops when the process is out of file descriptors, since
+ * the waiting players would otherwise wake epoll up over and over, and starts again when a session closes. */
+
+void watchListener(struct server *server, int on)
+{
+	struct epoll_event event;
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = server->listenfd;
+	epoll_ctl(server->epollfd, on ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, server->listenfd, &event);
+	server->listening = on;
+}
+
+/* The acceptSessions function starts a session for every player waiting to connect, and shows them where they start. */
+
+void acceptSessions(struct server *server)
+{
+	for (;;)
+	{
+		struct session *session;
+		struct epoll_event event;
+		int sessionfd = accept4(server->listenfd, NULL, NULL, SOCK_NONBLOCK);
+
+		if (sessionfd == -1)
+		{
+			if (errno == EMFILE || errno == ENFILE)
+			{
+				watchListener(server, 0);
+			}
+
+			return;
+		}
+
+		if ((size_t)sessionfd >= server->sessionSlots) /* The sessions are kept by socket, so make room up to this one. */
+		{
+			size_t slots = (server->sessionSlots == 0) ? 1024 : server->sessionSlots;
+
+			while (slots <= (size_t)sessionfd)
+			{
+				slots *= 2;
+			}
+
+			server->sessions = realloc(server->sessions, slots * sizeof(struct session *));
+
+			if (server->sessions == NULL)
+			{
+				perror("Error: not enough memory for the sessions.");
+				exit(1);
+			}
+
+			memset(server->sessions + server->sessionSlots, 0, (slots - server->sessionSlots) * sizeof(struct session *));
+			server->sessionSlots = slots;
+		}
+
+		session = calloc(1, sizeof(struct session));
+
+		if (session == NULL || pickWorld(server, session) == -1)
+		{
+			free(session);
+			close(sessionfd);
+			continue;
+		}
+
+		session->fd = sessionfd;
+		server->sessions[sessionfd] = session;
+		server->numberOfSessions++;
+
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.fd = sessionfd;
+		epoll_ctl(server->epollfd, EPOLL_CTL_ADD, sessionfd, &event);
+
+		describeRoom(server, session);
+		flushSession(server, session);
+	}
+}
+
+/* The pickWorld function gives a new session its world, which is the next one of an archive that can be opened. A world is checked
+ * and pointed into the mapping the first time any session gets it. Returns 0, or -1 if no world could be opened. */
+
+int pickWorld(struct server *server, struct session *session)
+{
+	uint32_t tried; /* Loop control variable. */
+
+	for (tried = 0; tried < server->numberOfWorlds; tried++)
+	{
+		uint32_t worldNumber = server->nextWorld;
+		struct world *w = &server->worlds[worldNumber];
+
+		server->nextWorld = (worldNumber + 1) % server->numberOfWorlds;
+
+		if (w->startRoom == NO_ROOM) /* It could not be opened before. */
+		{
+			continue;
+		}
+
+		if (w->numberOfRooms == 0 && openWorld(w, server->fileName, server->mapping, server->mappingSize, worldNumber) == -1)
+		{
+			w->startRoom = NO_ROOM;
+			continue;
+		}
+
+		session->world = worldNumber;
+		session->room = w->startRoom;
+		return 0;
+	}
+
+	return -1;
+}
+
+/* The readSession function reads what a player sent, and makes a move for every whole line. A line too long for the session's
+ * buffer can't be the name of a room, so the rest of it is thrown away, and it counts as a room that isn't understood. */
+
+void readSession(struct server *server, struct session *session)
+{
+	char buffer[4096];
+	ssize_t length = read(session->fd, buffer, sizeof(buffer));
+	ssize_t i; /* Loop control variable. */
+
+	if (length == 0 || (length == -1 && errno != EAGAIN && errno != EINTR))
+	{
+		closeSession(server, session);
+		return;
+	}
+
+	for (i = 0; i < length && !session->finished; i++)
+	{
+		if (buffer[i] == '\r')
+		{
+			continue;
+		}
+
+		if (buffer[i] != '\n')
+		{
+			if (session->lineLength < SESSION_LINE - 1)
+			{
+				session->line[session->lineLength++] = buffer[i];
+			}
+
+			else
+			{
+				session->lineTooLong = 1;
+			}
+
+			continue;
+		}
+
+		session->line[session->lineLength] = '\0';
+		moveSession(server, session);
+		session->lineLength = 0;
+		session->lineTooLong = 0;
+	}
+
+	flushSession(server, session);
+}
+
+/* The moveSession function makes the move on the line of a session, just like playGame does at the keyboard. */
+
+void moveSession(struct server *server, struct session *session)
+{
+	struct world *w = &server->worlds[session->world];
+	uint32_t nextRoom = session->lineTooLong ? NO_ROOM : findRoom(w, session->line);
+	uint32_t i; /* Loop control variable. */
+
+	if (nextRoom != NO_ROOM && !connected(w, session->room, nextRoom))
+	{
+		nextRoom = NO_ROOM;
+	}
+
+	if (nextRoom == NO_ROOM)
+	{
+		sessionPrintf(session, "\nHUH? I DON'T UNDERSTAND THAT ROOM. TRY AGAIN.\n\n");
+		describeRoom(server, session);
+		return;
+	}
+
+	if (session->steps == session->pathCapacity) /* Double the path when it is full. */
+	{
+		session->pathCapacity = (session->pathCapacity == 0) ? 16 : session->pathCapacity * 2;
+		session->path = realloc(session->path, (size_t)session->pathCapacity * sizeof(uint32_t));
+
+		if (session->path == NULL)
+		{
+			perror("Error: not enough memory for a path.");
+			exit(1);
+		}
+	}
+
+	session->room = nextRoom;
+	session->path[session->steps++] = nextRoom;
+
+	if (nextRoom != w->endRoom)
+	{
+		sessionPrintf(session, "\n");
+		describeRoom(server, session);
+		return;
+	}
+
+	sessionPrintf(session, "\nYOU HAVE FOUND THE END ROOM. CONGRATULATIONS!\nYOU TOOK %u STEPS. YOUR PATH TO VICTORY WAS:\n", session->steps);
+
+	for (i = 0; i < session->steps; i++)
+	{
+		sessionPrintf(session, "%s\n", roomName(w, session->path[i]));
+	}
+
+	session->finished = 1; /* The session is closed once all of that has been sent. */
+}
+
+void describeRoom(struct server *server, struct session *session) /* Shows a player where they are, like the game at the keyboard does. */
+{
+	struct world *w = &server->worlds[session->world];
+	uint32_t connection;
+
+	sessionPrintf(session, "CURRENT LOCATION: %s\nPOSSIBLE CONNECTIONS: ", roomName(w, session->room));
+
+	for (connection = w->connectionStart[session->room]; connection < w->connectionStart[session->room + 1]; connection++)
+	{
+		sessionPrintf(session, "%s%s", roomName(w, w->connections[connection]), (connection + 1 == w->connectionStart[session->room + 1]) ? ".\n" : ", ");
+	}
+
+	sessionPrintf(session, "WHERE TO? >");
+}
+
+/* The sessionPrintf function adds to what is waiting to be sent to a player. The buffer only exists while there is something in it. */
+
+void sessionPrintf(struct session *session, const char *format, ...)
+{
+	va_list arguments;
+	int length;
+
+	va_start(arguments, format);
+	length = vsnprintf(NULL, 0, format, arguments);
+	va_end(arguments);
+
+	while (session->outputSize + length + 1 > session->outputCapacity)
+	{
+		session->outputCapacity = (session->outputCapacity == 0) ? 256 : session->outputCapacity * 2;
+		session->output = realloc(session->output, session->outputCapacity);
+
+		if (session->output == NULL)
+		{
+			perror("Error: not enough memory for a session.");
+			exit(1);
+		}
+	}
+
+	va_start(arguments, format);
+	vsnprintf(session->output + session->outputSize, length + 1, format, arguments);
+	va_end(arguments);
+	session->outputSize += length;
+}
+
+/* The flushSession function sends what is waiting for a player, as far as the socket takes it. Whatever is left is sent when epoll
+ * says the socket can take more, and until then the session is not read from. A finished session is closed once everything is sent. */
+
+void flushSession(struct server *server, struct session *session)
+{
+	struct epoll_event event;
+
+	while (session->outputSent < session->outputSize)
+	{
+		ssize_t sent = write(session->fd, session->output + session->outputSent, session->outputSize - session->outputSent);
+
+		if (sent == -1 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (sent == -1 && errno == EAGAIN)
+		{
+			if (!session->waiting)
+			{
+				memset(&event, 0, sizeof(event));
+				event.events = EPOLLOUT;
+				event.data.fd = session->fd;
+				epoll_ctl(server->epollfd, EPOLL_CTL_MOD, session->fd, &event);
+				session->waiting = 1;
+			}
+
+			return;
+		}
+
+		if (sent == -1)
+		{
+			closeSession(server, session);
+			return;
+		}
+
+		session->outputSent += sent;
+	}
+
+	free(session->output); /* Everything was sent, so the buffer goes until there is more. */
+	session->output = NULL;
+	session->outputSize = session->outputSent = session->outputCapacity = 0;
+
+	if (session->finished)
+	{
+		closeSession(server, session);
+		return;
+	}
+
+	if (session->waiting)
+	{
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.fd = session->fd;
+		epoll_ctl(server->epollfd, EPOLL_CTL_MOD, session->fd, &event);
+		session->waiting = 0;
+	}
+}
+
+void closeSession(struct server *server, struct session *session) /* Ends a session, and gives back everything it had. */
+{
+	epoll_ctl(server->epollfd, EPOLL_CTL_DEL, session->fd, NULL);
+	close(session->fd);
+	server->sessions[session->fd] = NULL;
+	server->numberOfSessions--;
+	free(session->output);
+	free(session->path);
+	free(session);
+
+	if (!server->listening) /* There is a file descriptor free again. */
+	{
+		watchListener(server, 1);
+	}
 }
\ No newline at end of file
@@ -11,9 +11,42 @@
 ** and background. The shell can also interupt processes with a CTRL-C command from the keyboard. The shell prints error 
 ** messages as appropriate. The shell also prints out the process id of background processes when they begin, and prints 
 ** out when they are complete. Whenever a child foreground process is killed, the parent will print out the number of the 
-** signal that killed it. 
+** signal that killed it. Commands can be chained into pipelines with |, where every stage runs at the same time. The 
+** splicecat and splicetee built in commands copy data with the splice and tee system calls, so that a stream moving 
+** through a pipeline does not have to be copied in and out of the shell. 
+**
+** Running "smallsh scriptfile" runs the commands in the file instead of reading them from the keyboard. The file is
+** memory mapped and split into lines in place, no prompts are printed, and when the script ends the shell prints the 
+** total wall time and timing statistics for the commands to standard error.
+**
+** The parallel built in command runs one command for each of a list of inputs, keeping a number of them running at
+** once, like xargs -P or GNU parallel: "parallel [-j jobs] command [arguments] ::: input ..." or with ":::: file" to 
+** read the inputs from the lines of a file. {} in the arguments is replaced by the input, otherwise the input is added
+** as the last argument. The number of jobs defaults to the number of processors.
+**
+** Like bash, the shell remembers where in PATH it found each command, so PATH is only searched the first time a command
+** is run. The hash built in lists the remembered commands, "hash -r" forgets them, and "hash name" looks a name up.
+**
+** "time command" runs a command and then prints its wall, user and system time, largest resident set size and context
+** switches to standard error. jobs lists the running background processes, and "jobs -v" adds the same numbers for the
+** last jobs that finished, which are collected with wait4() for every job.
+**
+** Lines are split into words like other shells do: 'single' and "double" quotes, backslashes, $$ for the process id of
+** the shell, and | < > & without spaces around them. A # starts a comment only at the start of a word, and & only
+** means background at the end of a line. Lines can be any length. "smallsh -n [scriptfile]" only parses the lines and
+** reports syntax errors, without running anything.
+**
+** In the foreground, echo, cat, test, [, ls and wc run inside the shell instead of starting a process, for their common
+** options. With any other option the real program runs instead. SMALLSH_BUILTINS limits which of them are done in the
+** shell, like "SMALLSH_BUILTINS=echo,test", and setting it to nothing turns them all off.
+**
+** Lines typed at the keyboard are added to ~/.smallsh_history, with when they ran, how long they took and their status.
+** "history [N]" lists them, "history -p text" lists the ones that start with text, "history -t [N]" lists the lines
+** that took the most time in total, and !!, !N and !text run an earlier line again.
 *************************/
 
+#define _GNU_SOURCE /* Exposes splice(), tee(), sendfile() and pipe2(), which are Linux specific. */
+
 #include <stdio.h> /* Needed for things like printf, fgets, sprintf and perror. */
 #include <stdlib.h> /* Needed for things such as malloc, execvp, and exit. */
 #include <string.h> /* For various string operations such as strcmp and strtok. */
@@ -25,6 +58,18 @@
 #include <sys/stat.h> /* Provides various status information. */
 #include <sys/wait.h> /* Used for waitpid(). */
 #include <sys/types.h> /* provides definition for data types ssize_t and pid_t.*/
+#include <spawn.h> /* Provides posix_spawn() and its file actions, which start commands without copying the shell with fork(). */
+#include <sys/sendfile.h> /* Provides sendfile(), used by splicecat when neither side is a pipe. */
+#include <errno.h> /* Provides errno, to tell when splice() cannot be used. */
+#include <sys/mman.h> /* Provides mmap(), used to read script files. */
+#include <time.h> /* Provides clock_gettime(), used to time the commands of a script. */
+#include <dirent.h> /* Provides opendir() and readdir(), for the ls built in. */
+#include <locale.h> /* Provides setlocale(), so that ls sorts names the way the real ls does. */
+#include <sys/resource.h> /* Provides wait4() and struct rusage, what each job used for the time and jobs built in commands. */
+#include <stdint.h> /* Provides the fixed size integers of the history file. */
+#include <sys/uio.h> /* Provides writev(), which writes a history record in one call. */
+
+extern char **environ; /* The environment of the shell, handed to every command it spawns. */
 
 /* Here I place some variables before the main function, that will be used. */
 
@@ -42,371 +87,3983 @@ int inputWasNull = 0;
 
 int background = 0;
 
-char inputLine[2048]; /* According to the assignment requirements, the shell must support command lines of up to 2048 characters, which explains the size.
-					     This is a c-string that holds the command line input from the user.*/
+/* The command line being run. It used to be a fixed array of 2048 characters, the length the assignment requires, cut up in place by strtok.
+   Now it points either into inputBuffer, which getline() grows to fit any line, or straight into a mapped script, and is not NUL terminated,
+   since parseLine() copies the words out of it anyway. */
+
+char *inputLine = NULL;
+size_t inputLength = 0;
+char *inputBuffer = NULL; /* The getline() buffer, kept from line to line. */
+size_t inputCapacity = 0;
+
+/* parseLine() turns a line into a commandLine: the commands of a pipeline, each with a NULL terminated list of arguments and its < and >
+   files, and whether the line ends with &. A line is first split into tokens, the words and the |, <, > and & operators. All of it,
+   including the text of the words, is allocated from an arena of blocks that are reset for every line instead of being freed, so after
+   the first few lines the parser does not touch the heap at all. */
+
+enum { TOKEN_WORD, TOKEN_PIPE, TOKEN_INPUT, TOKEN_OUTPUT, TOKEN_BACKGROUND };
+
+struct token
+{
+	int type;
+	char *word; /* The text of a word, after quotes and $$ are taken care of. NULL for the operators. */
+};
+
+struct tokenizer
+{
+	char *text; /* The line, and its length. */
+	size_t length;
+	struct token *tokens; /* Where the tokens go, or NULL to only count them. */
+	char *words; /* Where the text of the words goes. */
+	int numberOfTokens;
+	size_t wordBytes; /* How many bytes the words need, NUL characters included. */
+	int sawComment;
+	char *error; /* What went wrong, if tokenize() returns -1. */
+};
+
+struct simpleCommand
+{
+	char **arguments; /* Ends with NULL. */
+	int numberOfArguments;
+	char *inputFile; /* From <, or NULL. */
+	char *outputFile; /* From >, or NULL. */
+};
+
+struct commandLine
+{
+	struct simpleCommand *commands;
+	int numberOfCommands; /* 0 for a blank line or a comment. More than 1 for a pipeline. */
+	int inBackground; /* 1 if the line ended with &. */
+	int sawComment;
+};
+
+#define ARENA_BLOCK_SIZE 65536
+
+struct arenaBlock
+{
+	struct arenaBlock *next;
+	size_t size; /* Bytes of data in the block. */
+	size_t used;
+	char data[];
+};
+
+struct arenaBlock *firstBlock = NULL;
+struct arenaBlock *currentBlock = NULL; /* The block allocations are coming from. */
+
+struct commandLine currentLine; /* The line being run. */
+char shellProcessID[16]; /* The process id of the shell as text, for $$. */
+
+/* echo, cat, test, [, ls and wc are simple enough to run inside the shell, which saves starting a process for each of them. Their output
+   is collected in builtinBuffer and written to builtinOutput in large pieces, and cat moves file data with moveData(). */
+
+#define WC_LINES 1
+#define WC_WORDS 2
+#define WC_BYTES 4
+
+char builtinBuffer[65536];
+size_t builtinBuffered = 0;
+int builtinOutput = STDOUT_FILENO;
+int parseOnly = 0; /* 1 with -n, where lines are parsed but not run. */
+int syntaxErrors = 0; /* How many lines had syntax errors. */
+
+/* The background processes are kept in a job table, a hash table keyed on the process id. It used to be a fixed array of 250 process ids
+   that checkProcesses() polled one by one with waitpid() after every command, which costs one system call per background process
+   per prompt and overruns after 250 of them. Now a SIGCHLD handler only sets childExited, and checkProcesses() reaps with waitpid(-1)
+   until nothing is left, so the work is proportional to the processes that actually finished. The table uses open addressing with
+   linear probing, and doubles whenever it gets half full, so there is no limit besides memory. */
+
+struct job
+{
+	pid_t processID; /* 0 marks an empty slot. */
+	struct timespec started; /* When it was started, for its wall time. */
+	char *command; /* The name of the command, for the jobs built in. */
+};
+
+struct job *jobTable = NULL;
+size_t jobTableSize = 0; /* Number of slots, always a power of two. */
+size_t jobCount = 0; /* Number of background processes in the table. */
+
+volatile sig_atomic_t childExited = 0; /* Set by the SIGCHLD handler, cleared by checkProcesses(). */
+
+/* A background job is only reaped once the shell comes back around its loop, which can be long after it ended if the user sits at the
+   prompt. So the SIGCHLD handler notes the time each child ended in exitTimes, a ring of the last EXIT_TIMES children, and the wall
+   time of a job is measured up to then instead of up to when it was reaped. clock_gettime() is safe to call from a handler. If two
+   children end so close together that their signals come in as one, the one that was missed gets the time of the last signal. */
+
+#define EXIT_TIMES 64
+
+struct exitTime
+{
+	volatile pid_t processID; /* 0 once the time has been used. */
+	struct timespec ended;
+};
+
+struct exitTime exitTimes[EXIT_TIMES];
+volatile sig_atomic_t exitTimeCount = 0; /* Every child the handler noted. The newest is at exitTimeCount - 1, modulo EXIT_TIMES. */
+
+/* Every job the shell waits for is reaped with wait4(), which also hands back the rusage of the process: its user and system time,
+   largest resident set size and context switches. The last JOB_HISTORY finished jobs are kept for jobs -v, in a ring so nothing has to
+   be freed. While the time built in is running, the rusage of the foreground jobs is added up in timedChildren. */
+
+#define JOB_HISTORY 32
+
+struct jobRecord
+{
+	pid_t processID;
+	char command[64];
+	int inBackground;
+	int status; /* As returned by wait4(). */
+	long long wallTime; /* In nanoseconds. */
+	struct rusage usage;
+};
+
+struct jobRecord finishedJobs[JOB_HISTORY];
+long finishedJobCount = 0; /* Every job that ever finished. The newest is at finishedJobCount - 1, modulo JOB_HISTORY. */
+
+int timeBuiltinRunning = 0;
+struct timespec timeBuiltinStart;
+struct rusage timeBuiltinSelf; /* What the shell itself had used when time started. */
+struct rusage timedChildren; /* What the timed foreground jobs used. */
+
+/* Like the hash command of bash, the shell remembers where in PATH each command was found, so that running the same command again
+   does not have to try every directory of PATH. The table is keyed on the command name, with open addressing like the job table.
+   hashedPath is the PATH the table was filled from, and the whole table is forgotten once PATH is different. */
+
+struct hashedCommand
+{
+	char *name; /* NULL marks an empty slot. */
+	char *path; /* Where the command was found. */
+	unsigned long hits; /* How many times the command was run from here, for the hash built in. */
+};
 
-int backgroundProcesses[250]; /* This is an array of integers that keeps track of the various processes running in the background, storing the process ID's of each background process. 
-							     Technically, this can be overrun if there are over 250 background processes, but I didn't want to 
-								 deal with the memory issues. It is hard to actually exceed 250 background processes on accident. 
-								 I came up with this estimate by counting how many processes were running on my computer (120), and roughly 
-								 doubled that to be safe.*/
+struct hashedCommand *commandTable = NULL;
+size_t commandTableSize = 0; /* Number of slots, always a power of two. */
+size_t commandCount = 0;
+char *hashedPath = NULL;
 
-int i; /* Loop control variable. Only one needed because no nested loops here. */
 int statusStatus; /* Not to be confused with the various local status variables, this variable holds the integer printed if the status command
 				    is used. The name might be a bit confusing, but it's funny. It holds the exit status or termination signal of the last foreground command.*/
 
-int backgroundProcessNumber; /* Simple integer that stores the current number of background processes active in the shell.*/
-
-/* Here I forward declare two helper functions that I will be using as part of the main function, processInput() and checkProcesses().*/
+/* When a script file is given, scriptMode is 1 and the whole file is mapped at scriptData. scriptOffset is where the next line starts.
+   The timing variables collect the statistics printed when the script is done. Times are in nanoseconds. */
+
+int scriptMode = 0;
+char *scriptData;
+size_t scriptSize;
+size_t scriptOffset = 0;
+
+struct timespec scriptStart; /* When the script started running. */
+struct timespec commandStart; /* When the current command started running. */
+int commandRunning = 0; /* 1 while a command of the script is being timed. */
+long commandsTimed = 0; /* How many commands were timed. */
+long long totalCommandTime = 0, shortestCommandTime = -1, longestCommandTime = 0;
+char *timedCommandName; /* The command being timed, which stays in the arena until the next line is parsed. */
+char slowestCommand[2048]; /* The name of the slowest command, to point at what to look at first. */
+
+/* Lines typed at the keyboard are kept in the history file, ~/.smallsh_history, or $SMALLSH_HISTFILE. It starts with HISTORY_MAGIC, which
+   holds the version, followed by one record per line: when the line was run and how long it took, in nanoseconds, the status it left and its
+   text. Records are padded to 8 bytes, and are only ever added to the end, so the file is never rewritten. At startup the file is mapped
+   and historyOffsets is filled with where each record starts. historySorted holds the entry numbers ordered by their text, for prefix
+   searches, and is only built the first time one is done. */
+
+#define HISTORY_MAGIC "SMALLSH1"
+#define HISTORY_HEADER_SIZE 8
+#define HISTORY_RECORD_SIZE(length) ((sizeof(struct historyRecord) + (length) + 7) & ~(size_t)7)
+
+struct historyRecord
+{
+	int64_t startTime; /* Since the epoch. */
+	int64_t duration;
+	int32_t exitStatus;
+	uint32_t length; /* Of the text, which is not NUL terminated. */
+	char text[];
+};
+
+struct historyTotal /* The time spent on one line, for history -t. */
+{
+	size_t entry; /* The first entry with the line. */
+	unsigned long runs;
+	long long time;
+};
+
+int historyEnabled = 0; /* 1 once the history file is open, which only happens at the keyboard. */
+int historyfd = -1;
+char *historyMap = NULL;
+size_t historyMapSize = 0;
+size_t *historyOffsets = NULL; /* Where each record starts in the file. */
+size_t historyCount = 0, historyCapacity = 0;
+size_t *historySorted = NULL;
+size_t historySortedCount = 0, historySortedCapacity = 0;
+int historyPending = 0; /* 1 while a line is running that still has to be added. */
+long long historyStartTime;
+struct timespec historyStart;
+
+/* Here I forward declare the helper functions that I will be using as part of the main function, processInput(), checkProcesses(), and the ones that
+   start commands, pipelines and the data moving built in commands.*/
 
 void processInput(void);
 void checkProcesses(void);
-
-int main()
+void reportBackgroundDone(pid_t processID, int status);
+void noteChildExited(int signalNumber, siginfo_t *information, void *context);
+long long wallTimeOf(pid_t processID, struct timespec *started);
+size_t jobSlot(pid_t processID);
+void addJob(pid_t processID, char *command, struct timespec *started);
+struct job *findJob(pid_t processID);
+void removeJob(struct job *job);
+size_t commandSlot(char *name);
+struct hashedCommand *findCommand(char *name);
+char *resolveCommand(char *name);
+void forgetCommand(char *name);
+void clearCommands(void);
+void runHash(char *commandArguments[], int numberOfArguments);
+void recordJob(pid_t processID, char *command, int inBackground, struct timespec *started, int status, struct rusage *usage);
+void addTimes(struct timeval *total, struct timeval *amount);
+void startTimeBuiltin(void);
+void finishTimeBuiltin(void);
+void runJobs(int verbose);
+int growInputs(char ***inputs, size_t *inputCapacity);
+int runParallel(struct simpleCommand *command);
+void openScript(char *fileName);
+long long nanosecondsSince(struct timespec *start);
+void finishCommandTiming(void);
+void reportTimings(void);
+int launchCommand(struct simpleCommand *command, int inBackground, int inputfd, int outputfd, pid_t *processID);
+int runPipeline(struct commandLine *line, int inBackground);
+int isDataBuiltin(char *command);
+int runDataBuiltin(struct simpleCommand *command, int inputfd, int outputfd);
+void *arenaAllocate(size_t size);
+void arenaReset(void);
+int tokenize(struct tokenizer *state);
+int parseLine(char *text, size_t length, struct commandLine *line);
+int isFileBuiltin(char *command);
+void builtinWrite(const char *data, size_t length);
+void builtinFlush(void);
+int runFileBuiltin(struct simpleCommand *command);
+int echoOptions(const char *word);
+int echoSupported(struct simpleCommand *command);
+int runEcho(struct simpleCommand *command);
+int catSupported(struct simpleCommand *command);
+int runCat(struct simpleCommand *command, int inputfd);
+int evaluateTest(char *operands[], int numberOfOperands);
+int lsSupported(struct simpleCommand *command);
+int compareNames(const void *first, const void *second);
+int runLs(struct simpleCommand *command);
+int wcOptions(struct simpleCommand *command);
+void countFile(int filefd, int counts, unsigned long long *lines, unsigned long long *words, unsigned long long *bytes);
+void printCounts(int counts, int width, unsigned long long lines, unsigned long long words, unsigned long long bytes, char *name);
+int runWc(struct simpleCommand *command, int inputfd);
+int moveData(int inputfd, int outputfd);
+void openHistory(void);
+int mapHistory(size_t size);
+void addHistoryOffset(size_t offset);
+struct historyRecord *historyEntry(size_t entry);
+void appendHistory(char *text, size_t length, long long startTime, long long duration, int exitStatus);
+void startHistoryEntry(void);
+void finishHistoryEntry(void);
+int compareHistoryText(struct historyRecord *record, const char *text, size_t length);
+int compareHistoryEntries(const void *first, const void *second);
+size_t findHistoryPrefix(const char *prefix, size_t length);
+int startsWith(struct historyRecord *record, const char *prefix, size_t length);
+int expandHistory(void);
+void printHistoryEntry(size_t entry);
+void runHistory(struct simpleCommand *command);
+int compareEntryNumbers(const void *first, const void *second);
+int compareTotals(const void *first, const void *second);
+
+int main(int argc, char *argv[])
 {
-	/* At first, I was debating wether or not to make this a do-while loop, but I realized that since I initialized timeToQuit as 0, 
+	struct sigaction childAction; /* SIGCHLD only sets a flag and notes the time. SA_RESTART keeps it from interrupting getline() and the foreground wait4(). */
+	memset(&childAction, 0, sizeof(childAction));
+	childAction.sa_sigaction = noteChildExited; /* SA_SIGINFO hands it the process id of the child. */
+	sigemptyset(&childAction.sa_mask);
+	childAction.sa_flags = SA_RESTART | SA_NOCLDSTOP | SA_SIGINFO;
+	sigaction(SIGCHLD, &childAction, NULL);
+
+	int firstArgument = 1;
+
+	if (argc > 1 && strcmp(argv[1], "-n") == 0) /* Like sh -n, only parse the commands and report syntax errors. */
+	{
+		parseOnly = 1;
+		firstArgument = 2;
+	}
+
+	if (argc > firstArgument) /* A file name means the shell runs that script instead of reading from the keyboard. */
+	{
+		openScript(argv[firstArgument]);
+	}
+
+	snprintf(shellProcessID, sizeof(shellProcessID), "%d", (int)getpid()); /* What $$ expands to. */
+	setlocale(LC_COLLATE, ""); /* Only the sorting order of the ls built in depends on it. */
+
+	if (scriptMode == 0 && parseOnly == 0 && isatty(STDIN_FILENO)) /* Only a person at the keyboard has a history, not scripts or piped input. */
+	{
+		openHistory();
+	}
+
+	/* At first, I was debating wether or not to make this a do-while loop, but I realized that since I initialized timeToQuit as 0,
 	   it would be guaranteed to execute at least once anyway. */
 
 	while (timeToQuit == 0)
 	{
 		/* To kick things off, we run the two helper functions, which checks background functions that have terminated, before giving the user control, and prints
-		   out the relevant information. processInput() then takes the users command line argument, and formats it in a string that the numerous conditionals in the 
-		   while loop can process using strcmp. */
+		   out the relevant information. processInput() then reads the users command line, and parseLine() turns it into a list of commands with their arguments
+		   and redirections, which the conditionals in the while loop check using strcmp. */
 
-		checkProcesses(); 
+		finishCommandTiming(); /* The previous command of a script, if any, is done once we are back here. */
+		finishTimeBuiltin(); /* Same for a command run with the time built in. */
+		finishHistoryEntry(); /* And the line that just ran goes into the history. */
+		checkProcesses();
 		processInput();
 
 		if (inputWasNull == 1)
 		{
-			return 0; /* If the user didn't enter anything for the input besides hitting the enter button, return and move on to the next iteration of the loop. */
+			if (parseOnly == 0)
+			{
+				reportTimings();
+			}
+			return (parseOnly == 1 && syntaxErrors > 0) ? 2 : 0; /* There is no more input, so the shell is done. */
 		}
 
-		else if (strcmp(inputLine, "exit") == 0) /* If they entered exit.*/
+		if (parseLine(inputLine, inputLength, &currentLine) == -1) /* parseLine() has already printed what is wrong with the line. */
 		{
-			timeToQuit = 1;
-			return 0; /* As timeToQuit is now 1, it will exit the while loop and end the shell properly. */
+			statusStatus = 1;
+			continue;
+		}
+
+		if (parseOnly == 1)
+		{
+			continue;
 		}
 
-		else if (strstr(inputLine, "#")) /* If the beginning of the input is a hashtag (#), it is a comment, and we ignore it. */
+		if (currentLine.numberOfCommands == 0) /* A blank line, or only a comment. */
 		{
-			printf("\n You entered a comment. Ignoring. Please try again.\n");
-			fflush(stdout); /* Flush for safety */
+			if (currentLine.sawComment == 1 && scriptMode == 0) /* Comments are normal in a script, so only tell a person at the keyboard about them. */
+			{
+				printf("\n You entered a comment. Ignoring. Please try again.\n");
+				fflush(stdout); /* Flush for safety */
+			}
 			continue; /* Skip to the next iteration of the loop. */
 		}
 
-		else if (strcmp(inputLine, "status") == 0) /* If they entered status.*/
+		struct simpleCommand *firstCommand = &currentLine.commands[0];
+		char *command = firstCommand->arguments[0]; /* Holds the command the user entered. */
+		int builtinStatus; /* The exit status of a file utility that ran inside the shell. */
+		background = currentLine.inBackground;
+		startHistoryEntry();
+
+		/* Time every real command of a script, from here until we are back at the top of the loop. exit is not counted. */
+
+		if (scriptMode == 1 && strcmp(command, "exit") != 0)
 		{
-			printf("exit value %d", statusStatus); /* Here we print the exit status or terminating signal of the last foreground process.*/
+			clock_gettime(CLOCK_MONOTONIC, &commandStart);
+			timedCommandName = command;
+			commandRunning = 1;
 		}
 
-		/* strncmp compares two strings up to the length specified in the third parameter. In this case, we are taking cd and comparing it to the 
-		   command that the user entered, but only up to the first two letters of cd, because line will have further characters that denote what 
-		   directory they wish to change into. */
-		else if (strncmp("cd", inputLine, strlen("cd")) == 0) 
+		if (strcmp(command, "time") == 0) /* time runs the rest of the line as usual, and what it used is printed once it is done. */
 		{
-			/* This searches the third character of what the user inputted. If they entered a parameter, then there will naturally be a space after cd,
-			   so we can check if they entered something by checking for this space. */
+			startTimeBuiltin();
+			firstCommand->arguments++;
+			firstCommand->numberOfArguments--;
 
-			if (inputLine[2] == ' ') 
+			if (firstCommand->numberOfArguments == 0) /* time by itself, which has nothing to run. */
 			{
-				char workingDirectory[2045]; /* This creates a c-string that can hold the working directory the user entered. Because the max length of a user input is 2048,
-											    and the user already used 3 characters to type "cd ", the most characters they can use is 2045 to specify a working directory.*/
-				getcwd(workingDirectory, sizeof(workingDirectory)); /* Reads the current working directory. */
+				continue;
+			}
 
-				char *newDirectoryPath; /* Creates a c-string to hold the new directory path.*/
-				newDirectoryPath = strstr(inputLine, " "); /* Creates a substring on the inputted line up to the next space. */
+			command = firstCommand->arguments[0];
+		}
 
-				if (newDirectoryPath) /* If the substring isn't NULL, this is condition fires off.*/
-				{
-					/* Because the substring entered only goes up to the first space, we need to move up one space to actually reach the start of the argument for cd. */
-					newDirectoryPath += 1; 
-					char *pathValue; /* Value will store the value of the newDirectoryPath. */
-					
-					pathValue = malloc(strlen(newDirectoryPath)); /* Dynamically allocates memory for the new directory path. */
-					memcpy(pathValue, newDirectoryPath, strlen(newDirectoryPath)); /* Copy the value of newDirectorypath into pathValue, copying as many bytes as the length of newDirectoryPath.*/
-					*(pathValue + strlen(newDirectoryPath)) = 0; /* Add a null terminator to the end. */
-					sprintf(workingDirectory, "%s/%s", workingDirectory, pathValue); /* Combine the current working directory with the value of the new path the user specified to 
-																				        create a full directory to change into. This final result is stored in workingDirectory. */
-					free(pathValue); /* Free the memory used when dynamically allocating pathValue. */
-				}
+		if (currentLine.numberOfCommands > 1) /* Every stage of a pipeline is started by runPipeline(). */
+		{
+			runPipeline(&currentLine, background);
+		}
 
-				chdir(workingDirectory); /* Change into the new working directory. */
-			}
+		else if (strcmp(command, "exit") == 0) /* If they entered exit.*/
+		{
+			timeToQuit = 1;
+			reportTimings();
+			return 0; /* As timeToQuit is now 1, it will exit the while loop and end the shell properly. */
+		}
 
-			else /* If this is reached, then no space was entered after cd, meaning the user just entered cd by itself.
-					In this case, we just change to the home directory, as defined by the environmental variables.*/
-			{
-				char *homeLocation = getenv("HOME"); /* Grab the HOME environment variable using getenv.*/
-				chdir(homeLocation); /* Change the current working directory to the location of the home environment variable.*/
-			}
+		else if (strcmp(command, "status") == 0) /* If they entered status.*/
+		{
+			printf("exit value %d", statusStatus); /* Here we print the exit status or terminating signal of the last foreground process.*/
 		}
 
-		/* If we've reached this point, the input is neither NULL, a comment, or built in, meaning we need to execute some
-		   other program through the shell, either in the background or the foreground. */
-		else 
+		else if (strcmp(command, "jobs") == 0) /* The jobs built in lists the background processes, and with -v what the last jobs used. */
 		{
-			pid_t processID; /* Creates a pid_t type variable to hold the process id. */
-			int status; /* Local status variable.*/
+			runJobs(firstCommand->numberOfArguments > 1 && strcmp(firstCommand->arguments[1], "-v") == 0);
+		}
 
-			char *command; /* Holds the command the user entered. */
-			char *commandArguments[512]; /* Holds every argument in an array of c-strings. 512 is the max as per the assignment specifications.*/
-			int numberOfArguments; /* Holds the number of arguments. */
-			int redirectionInvolved = 0; /* This is a boolean variable that accounts for wether or not the process involves redirection. By default, it is set to 0.*/
+		else if (strcmp(command, "hash") == 0) /* The hash built in shows or changes the remembered command locations. */
+		{
+			runHash(firstCommand->arguments, firstCommand->numberOfArguments);
+		}
 
-			command = strtok(inputLine, " "); /* Reads the command line input up to the first space. */
-			if (command == NULL)  /* If this is reached, there is no command. */
-			{
-				continue; /* Move on to the next iteration of the shell loop.*/
-			}
+		else if (strcmp(command, "history") == 0) /* The history built in lists and searches the lines typed before. */
+		{
+			runHistory(firstCommand);
+		}
 
-			commandArguments[0] = command; /* Set the first command argument to command, which now is set to the first argument, so it works out.*/
-			numberOfArguments = 1;
-			commandArguments[numberOfArguments] = strtok(NULL, " "); /* Place the next argument into the next space of the array. */
+		/* cd with no argument changes to the home directory, as defined by the environmental variables. Otherwise the argument is handed to
+		   chdir() as it is, since chdir() already takes both full paths and paths relative to the current working directory. */
+		else if (strcmp(command, "cd") == 0)
+		{
+			char *newDirectoryPath = (firstCommand->numberOfArguments > 1) ? firstCommand->arguments[1] : getenv("HOME");
 
-			while (commandArguments[numberOfArguments] != NULL) /* While there are still arguments to place in.*/
+			if (newDirectoryPath != NULL && chdir(newDirectoryPath) == -1)
 			{
-				numberOfArguments++; /* Increment the number of arguments. */
-				commandArguments[numberOfArguments] = strtok(NULL, " "); /* Read in arguments into the arguments array until there are none left.*/
+				printf("cd: %s: %s\n", newDirectoryPath, strerror(errno));
+				fflush(stdout);
 			}
+		}
 
-			if (background == 1) /* If the user intended to start the process in the background.*/
-			{
-				if ((processID = fork()) < 0) /* If the fork went wrong, it will return a status below 0, like -1. This is what we are checking for.*/
-				{
-					perror("An error occured while forking."); /* Write the error message.*/
-					exit(1); /* Exit.*/
-				}
+		else if (strcmp(command, "parallel") == 0) /* The parallel built in runs many copies of a command itself, and sets the status when they are all done. */
+		{
+			statusStatus = runParallel(firstCommand);
+		}
 
-				if (processID == 0) /* If the process id equals 0, then this is the child process.*/
-				{
-					for (i = 0; i < numberOfArguments; i++) /* For every argument*/
-					{
-						if (strcmp(commandArguments[i], "<") == 0) /* See if one of the arguments is <, if so, we need to redirect input.*/
-						{
-							if (access(commandArguments[i + 1], R_OK) == -1) /* If the file involved with redirection cannot be read,*/
-							{
-								printf("Cannot open %s to redirect input.\n", commandArguments[i + 1]); /* Print so*/
-								fflush(stdout); /*flush for safety. */
-								redirectionInvolved = 1; /* and set redirection as involved through the boolean variable.*/
-							}
+		/* splicecat and splicetee run right inside the shell when they are not part of a pipeline, since there is nothing to run at the same time. */
 
-							else /* Otherwise, the file can be read.*/
-							{
-								int fileDescriptor = open(commandArguments[i + 1], O_RDONLY, 0); /* Create a file descriptor and open the argument after the < symbol in Read only mode.*/
-								dup2(fileDescriptor, STDIN_FILENO); /* Redirect the input via duplication. */
-								close(fileDescriptor); /* Close file descriptor.*/
-								redirectionInvolved = 1; /* set redirection as involved through the boolean variable. */
-								execvp(command, &command); /* Execute the command. */
-							}
-						}
+		else if (isDataBuiltin(command))
+		{
+			statusStatus = runDataBuiltin(firstCommand, STDIN_FILENO, STDOUT_FILENO);
+		}
 
-						if (strcmp(commandArguments[i], ">") == 0) /* See if one of the arguments is >, if so, we need to redirect output. */
-						{
-							int fileDescriptor = creat(commandArguments[i + 1], 0644); /* Creates a file to output to.*/
-							dup2(fileDescriptor, STDOUT_FILENO); /* Redirects the output via duplication.*/
-							close(fileDescriptor); /* Close file descriptor.*/
-							redirectionInvolved = 1; /* set redirection as involved through the boolean variable. */
-							execvp(command, &command); /* Execute the command. */
-						}
-					}
+		/* echo, cat, test, [, ls and wc run inside the shell in the foreground, unless SMALLSH_BUILTINS leaves them out, or runFileBuiltin() finds
+		   an option it does not handle and returns -1 without doing anything, in which case the real program is started below as usual. */
 
-					if (redirectionInvolved == 0) /* If there is no redirection*/
-					{
-						execvp(command, commandArguments); /* Execute the command, using all the command arguments. */
-					}
+		else if (background == 0 && isFileBuiltin(command) && (builtinStatus = runFileBuiltin(firstCommand)) != -1)
+		{
+			statusStatus = builtinStatus;
+		}
 
-					/* This point can only be reached if there is an error. */
-					printf("Some error occured.\n");
-					fflush(stdout); /* Flush for safety*/
-					exit(1); /* Exit with an error. */
-				}
+		/* If we've reached this point, the input is neither NULL, a comment, or built in, meaning we need to execute some
+		   other program through the shell, either in the background or the foreground. */
+		else
+		{
+			pid_t processID; /* Creates a pid_t type variable to hold the process id. */
+			int status; /* Local status variable.*/
+			struct timespec started; /* When the command started, for its wall time. */
+			struct rusage usage; /* What the command used, filled in by wait4(). */
 
-				else /* If it isn't a child, it must be a parent process.*/
-				{
-					int status; /* Local status variable.*/
-					int process;  /* Holds the result of doing the waitpid command. */
-					printf("background pid is %d\n", processID); /* Write the proccess id of the parent background process that is being started.*/
-					fflush(stdout); /* Flush for safety*/
-					backgroundProcesses[backgroundProcessNumber] = processID; /* Add the process ID of the newly started background process to the array of background processes.*/
-					backgroundProcessNumber++; /* Increment the number of background processes after adding the process id to the array.*/
-					process = waitpid(processID, &status, WNOHANG); /* Performs the waitpid command on the background process with no delay. */
-					continue; /* Head to the next loop of the shell, as this process is running in the background. */
-				}
-			}
+			/* The command is started through launchCommand(), which uses posix_spawn instead of fork and exec, and sets up any < and > redirection
+			   as part of the spawn. If it fails, it has already printed why, and a failed foreground command counts as an exit value of 1. */
 
-			else /* If this is reached, the process the user intends to execute using the shell must be a foreground one.*/
+			clock_gettime(CLOCK_MONOTONIC, &started);
+
+			if (launchCommand(firstCommand, background, -1, -1, &processID) == -1)
 			{
-				if ((processID = fork()) < 0) /* If the fork went wrong, it will return a status below 0, like -1. This is what we are checking for.*/
+				if (background == 0)
 				{
-					perror("An error occured while forking."); /* Write the error message.*/
-					exit(1); /* Exit.*/
+					statusStatus = 1;
 				}
+				continue; /* Nothing was started, so move on to the next iteration of the shell loop. */
+			}
 
-				if (processID == 0) /* If the foreground process to be started is a child process.*/
-				{
-					/* Note, the following is an exact copy paste of the code I put above, because input and output redirection for a child
-					   process works exactly the same, regardless if the child process was started in the background or foreground.*/
-
-					for (i = 0; i < numberOfArguments; i++) /* For every argument*/
-					{
-						if (strcmp(commandArguments[i], "<") == 0) /* See if one of the arguments is <, if so, we need to redirect input.*/
-						{
-							if (access(commandArguments[i + 1], R_OK) == -1) /* If the file involved with redirection cannot be read,*/
-							{
-								printf("Cannot open %s to redirect input.\n", commandArguments[i + 1]); /* Print so*/
-								fflush(stdout); /*flush for safety. */
-								redirectionInvolved = 1; /* and set redirection as involved through the boolean variable.*/
-							}
-
-							else /* Otherwise, the file can be read.*/
-							{
-								int fileDescriptor = open(commandArguments[i + 1], O_RDONLY, 0); /* Create a file descriptor and open the argument after the < symbol in Read only mode.*/
-								dup2(fileDescriptor, STDIN_FILENO); /* Redirect the input via duplication. */
-								close(fileDescriptor); /* Close file descriptor.*/
-								redirectionInvolved = 1; /* set redirection as involved through the boolean variable. */
-								execvp(command, &command); /* Execute the command. */
-							}
-						}
-
-						if (strcmp(commandArguments[i], ">") == 0) /* See if one of the arguments is >, if so, we need to redirect output. */
-						{
-							int fileDescriptor = creat(commandArguments[i + 1], 0644); /* Creates a file to output to.*/
-							dup2(fileDescriptor, STDOUT_FILENO); /* Redirects the output via duplication.*/
-							close(fileDescriptor); /* Close file descriptor.*/
-							redirectionInvolved = 1; /* set redirection as involved through the boolean variable. */
-							execvp(command, &command); /* Execute the command. */
-						}
-					}
-
-					if (redirectionInvolved == 0) /* If there is no redirection*/
-					{
-						execvp(command, commandArguments); /* Execute the command, using all the command arguments. */
-					}
+			if (background == 1) /* If the user intended to start the process in the background.*/
+			{
+				printf("background pid is %d\n", processID); /* Write the proccess id of the parent background process that is being started.*/
+				fflush(stdout); /* Flush for safety*/
+				addJob(processID, command, &started); /* Add the process ID of the newly started background process to the job table.*/
+				continue; /* Head to the next loop of the shell, as this process is running in the background. */
+			}
 
-					/* This point can only be reached if there is an error. */
-					printf("Some error occured.\n");
-					fflush(stdout); /* Flush for safety*/
-					exit(1); /* Exit with an error. */
-				}
+			else /* If this is reached, the process the user intends to execute using the shell must be a foreground one.*/
+			{
+				wait4(processID, &status, 0, &usage); /* Wait for the process to end, and get what it used.*/
+				recordJob(processID, command, 0, &started, status, &usage);
 
-				else /* If this point is reached, the process intended to start is a foreground parent process.*/
+				if (WIFEXITED(status)) /* If the process exited with a status*/
 				{
-					int status; /* Local status variable.*/
-					waitpid(processID, &status, 0); /* Wait for the process to end.*/
-
-					if (WIFEXITED(status)) /* If the process exited with a status*/
-					{
-						statusStatus = WEXITSTATUS(status); /* Set the statusStatus equal to the exit status. This will be called in the coming
-															   shell loops until another foreground loop is run, at which point the statusStatus
-															   will be overwritten with the new status. */
-					}
+					statusStatus = WEXITSTATUS(status); /* Set the statusStatus equal to the exit status. This will be called in the coming
+														   shell loops until another foreground loop is run, at which point the statusStatus
+														   will be overwritten with the new status. */
 				}
+			}
 
-			} 
-
-		} 
+		}
 
 		signal(SIGINT, SIG_IGN); /* If an interrupt signal is found, catch and ignore it. */
-	} 
+	}
 
 	return 0; /* Do everything to exit the shell properly. */
 }
 
 /****************************
 **                                          void processInput(void)
-** Description: This function takes the command line input from the user and takes out the newline, replacing
-** it with a null terminator. I have done this numerous times in CS 261, and it is no different here. The string 
-** that results from this function is later processed through multiple conditional statements within the while 
-** loop of the shell, using strcmp to check for various conditions and characters in the users command line input. 
+** Description: This function reads the next command line and takes out the newline. Lines from the keyboard are read
+** with getline(), into a buffer that grows to fit the longest line so far and is then reused, so there is no limit on
+** the length of a line. Lines of a script are not copied at all: inputLine points right into the mapped file. Either
+** way inputLine is not NUL terminated, and inputLength says where it ends. The line is later parsed by parseLine().
 ****************************/
 
 void processInput(void)
 {
+	inputWasNull = 0; /* We set inputWasNull back to 0, because otherwise after the first blank input, it would permanently be set to 1. */
+
+	if (scriptMode == 1) /* Scripts get their next line from the mapped file, without a prompt or any flushing. */
+	{
+		char *lineEnd; /* Where the newline of the current line is, if it has one. */
+
+		if (scriptOffset >= scriptSize) /* The end of the script counts as the end of the input. */
+		{
+			inputWasNull = 1;
+			return;
+		}
+
+		inputLine = scriptData + scriptOffset;
+		lineEnd = memchr(inputLine, '\n', scriptSize - scriptOffset);
+		inputLength = (lineEnd != NULL) ? (size_t)(lineEnd - inputLine) : scriptSize - scriptOffset;
+		scriptOffset += inputLength + 1;
+		return;
+	}
+
 	/* First, we flush the standard input and standard output streams to be safe. */
 	fflush(stdout);
 	fflush(stdin);
 
-	printf(": "); /* Here we print a colon symbol, because the assignment requirements say it must be the prompt for each command line.*/
+	if (parseOnly == 0)
+	{
+		printf(": "); /* Here we print a colon symbol, because the assignment requirements say it must be the prompt for each command line.*/
+	}
 
 	/* Flushing standard output and input again to be safe.*/
 	fflush(stdout); /* Warning, this line was not in the original code. Delete this line if the program doesn't work. Also delete this comment if the program does work with it. */
 	fflush(stdin);
 
-	inputWasNull = 0; /* We set inputWasNull back to 0, because otherwise after the first blank input, it would permanently be set to 1. */
+	ssize_t lineLength = getline(&inputBuffer, &inputCapacity, stdin);
+
+	if (lineLength == -1) /* If this is reached, there is no more input, because it was closed or ended. inputWasNull becomes 1 to reflect this.*/
+	{
+		inputWasNull = 1;
+		return;
+	}
+
+	if (lineLength > 0 && inputBuffer[lineLength - 1] == '\n') /* Take out the newline at the end of the line, if there is one. */
+	{
+		lineLength--;
+	}
+
+	inputLine = inputBuffer;
+	inputLength = lineLength;
+
+	/* !! and the like are replaced by a line from the history, the same way other shells do it. "! " is left alone. */
 
-	if (fgets(inputLine, sizeof(inputLine), stdin) != NULL) /* Run fgets on the null line*/
+	if (historyEnabled == 1 && inputLength > 1 && inputLine[0] == '!' && inputLine[1] != ' ' && inputLine[1] != '\t' && inputLine[1] != '=')
 	{
-		char *position; /* This character pointer will store the position of the new line inevitably entered after the command line in the shell.*/
-		position = strchr(inputLine, '\n'); /* Set position to the newline's position. */
+		expandHistory();
+	}
+
+	return; /* Since it is a void function, it doesn't actually need to return anything. */
+}
+
+/****************************
+**                                                      void checkProcesses(void)
+** Description: Reaps the background processes that have ended since the last loop of the shell, before giving control
+** back to the user, and prints that they are done. Nothing is done unless a SIGCHLD came in. Otherwise waitpid(-1) with
+** WNOHANG is called until it has nothing left, so only the processes that finished cost anything. wait4() is used
+** instead of waitpid() to get what each one used, for jobs -v. Children that are not
+** in the job table are not ours to report and are just reaped.
+****************************/
+
+void checkProcesses(void)
+{
+	int status; /* Local status variable for the function. */
+	struct rusage usage; /* What the process used. */
+	pid_t processID;
+
+	if (childExited == 0)
+	{
+		return;
+	}
+
+	childExited = 0; /* Cleared before reaping, so a child that ends during the loop sets it again and is not missed. */
 
-		*position = '\0'; /* Dereference the position pointer to change the newline to a null terminator.*/
+	/* WNOHANG causes the waitpid to return immediately instead of blocking, with 0 once no more children have ended. */
 
-		/* We now re-appropriate position and use strchr again, searching for & this time. If there is an & in the command line,
-		   it indicates that the user intends to run the process in the background, and we can thus set the boolean variable accordingly. */
-		
-		position = strchr(inputLine, '&'); /* Sets position to a character pointer with the position where there is a & in the line, if any. */
-		if (position != NULL) /* For it to not be NULL, there must be a & somewhere in the command line. */
+	while ((processID = wait4(-1, &status, WNOHANG, &usage)) > 0)
+	{
+		struct job *job = findJob(processID);
+
+		if (job != NULL)
 		{
-			*position = '\0'; /* Like before, we can dereference the pointer and change it to a null terminator in order to remove it from the commmand line.
-							     That way, the & won't interfere with the conditionals that process the input. Having two null terminators right next to each 
-								 other doesn't matter because the string is terminated after the first one is read. */
-			background = 1; /* Background boolean is set to true, which assigns the processing of the command line to the proper conditionals. */
+			recordJob(processID, job->command, 1, &job->started, status, &usage);
+			removeJob(job);
+			reportBackgroundDone(processID, status);
 		}
+	}
+
+	return; /* Return nothing because void function. */
+}
+
+/****************************
+**                     void noteChildExited(int signalNumber, siginfo_t *information, void *context)
+** Description: The SIGCHLD handler. Notes when the child ended in exitTimes and sets a flag, since the reaping and printing
+** are not safe to do in a handler. SIGCHLD is blocked while it runs, so it never interrupts itself.
+****************************/
+
+void noteChildExited(int signalNumber, siginfo_t *information, void *context)
+{
+	struct exitTime *exitTime = &exitTimes[exitTimeCount % EXIT_TIMES];
+
+	(void)signalNumber; /* Only SIGCHLD comes here, and the context is not needed. */
+	(void)context;
+
+	exitTime->processID = 0; /* So that a half written slot is never matched. */
+	clock_gettime(CLOCK_MONOTONIC, &exitTime->ended);
+	exitTime->processID = information->si_pid;
+	exitTimeCount++;
+	childExited = 1;
+}
+
+/****************************
+**                         long long wallTimeOf(pid_t processID, struct timespec *started)
+** Description: Returns how many nanoseconds a child ran, from started to the time the SIGCHLD handler noted for it. The
+** newest notes are looked at first, so a reused process id finds its own. A child with no note, because its signal was merged
+** with a later one, ran until the newest note, and one that somehow ended before any signal ran until now.
+****************************/
+
+long long wallTimeOf(pid_t processID, struct timespec *started)
+{
+	struct timespec ended;
+	long newest = exitTimeCount; /* Read once, since the handler can move it. */
+	long count; /* Loop control variable. */
+
+	for (count = 1; count <= EXIT_TIMES && count <= newest; count++)
+	{
+		struct exitTime *exitTime = &exitTimes[(newest - count) % EXIT_TIMES];
 
-		else /* If this is reached, there is no & at the end of the line, meaning the user intends to run the process in the foreground. */
+		if (exitTime->processID == processID)
 		{
-			background = 0;
+			ended = exitTime->ended;
+			exitTime->processID = 0;
+			return (long long)(ended.tv_sec - started->tv_sec) * 1000000000LL + (ended.tv_nsec - started->tv_nsec);
 		}
 	}
 
-	else /* If this is reached, the user didn't enter anything in the shell, and just hit enter. inputWasNull becomes 1 to reflect this.*/
+	if (newest > 0)
 	{
-		inputWasNull = 1;
+		ended = exitTimes[(newest - 1) % EXIT_TIMES].ended;
+
+		if (ended.tv_sec > started->tv_sec || (ended.tv_sec == started->tv_sec && ended.tv_nsec > started->tv_nsec))
+		{
+			return (long long)(ended.tv_sec - started->tv_sec) * 1000000000LL + (ended.tv_nsec - started->tv_nsec);
+		}
 	}
 
-	return; /* Since it is a void function, it doesn't actually need to return anything. */
+	return nanosecondsSince(started);
 }
 
 /****************************
-**                                                      void checkProcesses(void)
-** Description: This function runs through the array of background processes in order to check if background processes have ended
-** after each loop of the shell, before giving control back to the user. If a process has exited, it is printed as such. 
+**                                      size_t jobSlot(pid_t processID)
+** Description: Returns the slot of the job table where a process id starts looking. Multiplying by a large odd constant
+** spreads out process ids, which usually come in order, before the table size is masked off.
+****************************/
 
-DEBUG NOTES: It is possible that I need to make status a pointer. Try this if the shell doesn't work properly. If you change this, change
-&status in the waitpid function to status.
+size_t jobSlot(pid_t processID)
+{
+	return ((size_t)processID * 2654435761u) & (jobTableSize - 1);
+}
+
+/****************************
+**                   void addJob(pid_t processID, char *command, struct timespec *started)
+** Description: Adds a background process to the job table, with a copy of its command name and when it was started,
+** doubling the table first if that would make it more than half full.
 ****************************/
 
-void checkProcesses(void)
+void addJob(pid_t processID, char *command, struct timespec *started)
 {
-	int status; /* Local status variable for the function. */
+	size_t slot;
 
-	for (i = 0; i < backgroundProcessNumber; i++) /* This for loop runs through the array of background process id's and checks if they have terminated between loops. */
+	if ((jobCount + 1) * 2 > jobTableSize)
 	{
-		/* Here we use &status instead of just status to fit the parameter requirements for waitpid. WNOHANG causes the waitpid to return information on the process
-		   immediately, without waiting for it to terminate. Otherwise, waitpid would be blocked until status information is avaliable. If there is no information,
-		   waitpid() will return 0 in this case. Because we are checking for background processes that have exited, we create a condition statement to check for status
-		   that are greater than 0. */
+		struct job *oldTable = jobTable;
+		size_t oldSize = jobTableSize;
+		size_t oldSlot;
+
+		jobTableSize = (oldSize == 0) ? 64 : oldSize * 2;
+		jobTable = calloc(jobTableSize, sizeof(struct job));
+
+		if (jobTable == NULL)
+		{
+			perror("smallsh: job table");
+			exit(1);
+		}
 
-		if (waitpid(backgroundProcesses[i], &status, WNOHANG) > 0)
+		for (oldSlot = 0; oldSlot < oldSize; oldSlot++) /* Every job has to be placed again, since its slot depends on the table size. */
 		{
-			/* If the background process is terminated by an unhandled exception, WTERMSIG holds the numer of the signal that terminated the process.
-			We print out this number.*/
-			if (WTERMSIG(status))
+			if (oldTable[oldSlot].processID != 0)
 			{
-				printf("background pid %d is done: terminated by signal %d", backgroundProcesses[i], WTERMSIG(status));
-				fflush(stdout); /* Flusing to be safe.*/
+				for (slot = jobSlot(oldTable[oldSlot].processID); jobTable[slot].processID != 0; slot = (slot + 1) & (jobTableSize - 1));
+				jobTable[slot] = oldTable[oldSlot];
 			}
-			
-			/* If the process exited normally, WIFEXITED will default to a true value instead of 0. Therefore, this conditional is
-			   only executed if the processes has actually exited. */
-			if (WIFEXITED(status)) 
-			{
-				/* If the background process exited, print out as such, with the process id and the exit status code. */
-				printf("background pid %d is done: exit value %d\n", backgroundProcesses[i], WEXITSTATUS(status)); 
-				fflush(stdout); /* Flushing stdout with every print statement as reccomended in the hints.*/
-			}	
 		}
+
+		free(oldTable);
 	}
 
-	return; /* Return nothing because void function. */
+	for (slot = jobSlot(processID); jobTable[slot].processID != 0; slot = (slot + 1) & (jobTableSize - 1));
+
+	memset(&jobTable[slot], 0, sizeof(struct job));
+	jobTable[slot].processID = processID;
+	jobTable[slot].started = *started;
+	jobTable[slot].command = strdup(command);
+	jobCount++;
+}
+
+/****************************
+**                                      struct job *findJob(pid_t processID)
+** Description: Returns the job of a background process, or NULL if it is not in the job table.
+****************************/
+
+struct job *findJob(pid_t processID)
+{
+	size_t slot;
+
+	if (jobCount == 0)
+	{
+		return NULL;
+	}
+
+	for (slot = jobSlot(processID); jobTable[slot].processID != 0; slot = (slot + 1) & (jobTableSize - 1))
+	{
+		if (jobTable[slot].processID == processID)
+		{
+			return &jobTable[slot];
+		}
+	}
+
+	return NULL;
+}
+
+/****************************
+**                                      void removeJob(struct job *job)
+** Description: Takes a job out of the job table. Instead of leaving a marker behind, the jobs after it in the same run
+** are moved back into the hole when their starting slot allows it, so lookups never have to step over removed jobs.
+****************************/
+
+void removeJob(struct job *job)
+{
+	size_t hole = job - jobTable;
+	size_t slot = hole;
+
+	free(jobTable[hole].command);
+	jobTable[hole].processID = 0;
+	jobCount--;
+
+	for (;;)
+	{
+		slot = (slot + 1) & (jobTableSize - 1);
+
+		if (jobTable[slot].processID == 0)
+		{
+			return;
+		}
+
+		/* The job can fill the hole unless its starting slot lies after the hole, up to where it is now. */
+
+		size_t start = jobSlot(jobTable[slot].processID);
+
+		if (((slot - start) & (jobTableSize - 1)) >= ((slot - hole) & (jobTableSize - 1)))
+		{
+			jobTable[hole] = jobTable[slot];
+			jobTable[slot].processID = 0;
+			hole = slot;
+		}
+	}
+}
+
+/****************************
+**                            void reportBackgroundDone(pid_t processID, int status)
+** Description: Prints that a background process is done, with either the signal that terminated it or its exit value.
+** Used by checkProcesses(), and by the parallel command when it happens to reap a background process.
+****************************/
+
+void reportBackgroundDone(pid_t processID, int status)
+{
+	/* If the background process is terminated by an unhandled exception, WTERMSIG holds the numer of the signal that terminated the process.
+	We print out this number.*/
+	if (WTERMSIG(status))
+	{
+		printf("background pid %d is done: terminated by signal %d", processID, WTERMSIG(status));
+		fflush(stdout); /* Flusing to be safe.*/
+	}
+	
+	/* If the process exited normally, WIFEXITED will default to a true value instead of 0. Therefore, this conditional is
+	   only executed if the processes has actually exited. */
+	if (WIFEXITED(status)) 
+	{
+		/* If the background process exited, print out as such, with the process id and the exit status code. */
+		printf("background pid %d is done: exit value %d\n", processID, WEXITSTATUS(status)); 
+		fflush(stdout); /* Flushing stdout with every print statement as reccomended in the hints.*/
+	}	
+}
+
+/****************************
+**                                      void *arenaAllocate(size_t size)
+** Description: Hands out memory from the parse arena. The blocks of the arena are never freed, only reused after
+** arenaReset(), so once the blocks are big enough for the lines being run, parsing a line does not call malloc at
+** all. A block that is too small for a request is skipped, and a new block is added at the end only when no block
+** is left, at least ARENA_BLOCK_SIZE bytes so that long lines only add one.
+****************************/
+
+void *arenaAllocate(size_t size)
+{
+	size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1); /* Keep everything aligned for pointers. */
+
+	while (currentBlock != NULL && currentBlock->size - currentBlock->used < size && currentBlock->next != NULL)
+	{
+		currentBlock = currentBlock->next;
+	}
+
+	if (currentBlock == NULL || currentBlock->size - currentBlock->used < size)
+	{
+		size_t blockSize = (size > ARENA_BLOCK_SIZE) ? size : ARENA_BLOCK_SIZE;
+		struct arenaBlock *block = malloc(sizeof(struct arenaBlock) + blockSize);
+
+		if (block == NULL)
+		{
+			perror("smallsh: parse arena");
+			exit(1);
+		}
+
+		block->next = NULL;
+		block->size = blockSize;
+		block->used = 0;
+
+		if (currentBlock == NULL)
+		{
+			firstBlock = block;
+		}
+
+		else
+		{
+			currentBlock->next = block;
+		}
+
+		currentBlock = block;
+	}
+
+	currentBlock->used += size;
+	return currentBlock->data + currentBlock->used - size;
+}
+
+/****************************
+**                                          void arenaReset(void)
+** Description: Makes all of the parse arena free again, which throws away the previous line and everything parsed from it.
+****************************/
+
+void arenaReset(void)
+{
+	struct arenaBlock *block;
+
+	for (block = firstBlock; block != NULL; block = block->next)
+	{
+		block->used = 0;
+	}
+
+	currentBlock = firstBlock;
+}
+
+/****************************
+**                                  int tokenize(struct tokenizer *state)
+** Description: Splits a line into words and the operators |, <, > and &, which do not need spaces around them. Single
+** quotes keep everything up to the next single quote as it is. Double quotes do the same, except that $$ is still
+** expanded and a backslash keeps a following ", \ or $ from being special. Outside quotes, a backslash keeps the next
+** character from being special, and $$ becomes the process id of the shell. A # at the start of a word begins a
+** comment that runs to the end of the line, while a # inside a word is just part of it.
+**
+** It runs twice on every line. The first time, state->tokens is NULL and only the number of tokens and the number of
+** bytes their words need are counted, so that the second run can write them into arrays of exactly the right size
+** from the arena. Returns 0, or -1 with state->error set if a quote is never closed.
+****************************/
+
+int tokenize(struct tokenizer *state)
+{
+	char *text = state->text;
+	size_t length = state->length;
+	size_t position = 0;
+	size_t wordBytes = 0; /* Where the next character of a word goes in state->words. */
+	size_t processIDLength = strlen(shellProcessID);
+
+	state->numberOfTokens = 0;
+	state->sawComment = 0;
+
+	for (;;)
+	{
+		while (position < length && (text[position] == ' ' || text[position] == '\t' || text[position] == '\r'))
+		{
+			position++;
+		}
+
+		if (position >= length)
+		{
+			break;
+		}
+
+		char character = text[position];
+		int type = TOKEN_WORD;
+
+		if (character == '#') /* Only a # that starts a word starts a comment. */
+		{
+			state->sawComment = 1;
+			break;
+		}
+
+		if (character == '|' || character == '<' || character == '>' || character == '&')
+		{
+			type = (character == '|') ? TOKEN_PIPE : (character == '<') ? TOKEN_INPUT : (character == '>') ? TOKEN_OUTPUT : TOKEN_BACKGROUND;
+			position++;
+		}
+
+		if (state->tokens != NULL)
+		{
+			state->tokens[state->numberOfTokens].type = type;
+			state->tokens[state->numberOfTokens].word = (type == TOKEN_WORD) ? state->words + wordBytes : NULL;
+		}
+
+		state->numberOfTokens++;
+
+		if (type != TOKEN_WORD)
+		{
+			continue;
+		}
+
+		/* Copy the word, one character or quoted part at a time, until a space or operator that is not quoted. */
+
+		while (position < length)
+		{
+			character = text[position];
+
+			if (character == ' ' || character == '\t' || character == '\r' || character == '|' || character == '<' || character == '>' || character == '&')
+			{
+				break;
+			}
+
+			if (character == '$' && position + 1 < length && text[position + 1] == '$')
+			{
+				if (state->words != NULL)
+				{
+					memcpy(state->words + wordBytes, shellProcessID, processIDLength);
+				}
+				wordBytes += processIDLength;
+				position += 2;
+			}
+
+			else if (character == '\\' && position + 1 < length)
+			{
+				if (state->words != NULL)
+				{
+					state->words[wordBytes] = text[position + 1];
+				}
+				wordBytes++;
+				position += 2;
+			}
+
+			else if (character == '\'' || character == '"')
+			{
+				char *closing = memchr(text + position + 1, character, length - position - 1);
+
+				if (closing == NULL)
+				{
+					state->error = (character == '\'') ? "unterminated '" : "unterminated \"";
+					return -1;
+				}
+
+				for (position++; text + position < closing; )
+				{
+					if (character == '"' && text[position] == '$' && position + 1 < length && text[position + 1] == '$')
+					{
+						if (state->words != NULL)
+						{
+							memcpy(state->words + wordBytes, shellProcessID, processIDLength);
+						}
+						wordBytes += processIDLength;
+						position += 2;
+						continue;
+					}
+
+					if (character == '"' && text[position] == '\\' && (text[position + 1] == '"' || text[position + 1] == '\\' || text[position + 1] == '$'))
+					{
+						position++; /* Skip the backslash and copy what follows it. */
+
+						if (text + position == closing) /* A \" does not close the quotes, so look for the next one. */
+						{
+							closing = memchr(text + position + 1, '"', length - position - 1);
+
+							if (closing == NULL)
+							{
+								state->error = "unterminated \"";
+								return -1;
+							}
+						}
+					}
+
+					if (state->words != NULL)
+					{
+						state->words[wordBytes] = text[position];
+					}
+					wordBytes++;
+					position++;
+				}
+
+				position++; /* Past the closing quote. */
+			}
+
+			else
+			{
+				if (state->words != NULL)
+				{
+					state->words[wordBytes] = character;
+				}
+				wordBytes++;
+				position++;
+			}
+		}
+
+		if (state->words != NULL)
+		{
+			state->words[wordBytes] = '\0';
+		}
+		wordBytes++;
+	}
+
+	state->wordBytes = wordBytes;
+	return 0;
+}
+
+/****************************
+**                 int parseLine(char *text, size_t length, struct commandLine *line)
+** Description: Parses a line into line, a list of the commands of a pipeline, each with its arguments and its < and >
+** files, and whether the line ends with &. Everything is allocated from the arena, which is reset first, so it stays
+** good until the next line is parsed. The text does not have to end with a NUL and is never changed, so a line of a
+** mapped script is parsed right where it is. A line with only spaces or a comment has no commands. Returns 0, or -1
+** after printing a syntax error.
+****************************/
+
+int parseLine(char *text, size_t length, struct commandLine *line)
+{
+	struct tokenizer state;
+	char *error = NULL;
+	int token, numberOfTokens, stage;
+
+	arenaReset();
+	memset(&state, 0, sizeof(state));
+	state.text = text;
+	state.length = length;
+
+	if (tokenize(&state) == 0) /* Count first, then fill in arrays of the right size. */
+	{
+		state.tokens = arenaAllocate((state.numberOfTokens + 1) * sizeof(struct token));
+		state.words = arenaAllocate(state.wordBytes + 1);
+		tokenize(&state);
+	}
+
+	else
+	{
+		error = state.error;
+	}
+
+	numberOfTokens = state.numberOfTokens;
+	line->sawComment = state.sawComment;
+	line->inBackground = 0;
+	line->numberOfCommands = 0;
+
+	if (error == NULL && numberOfTokens > 0 && state.tokens[numberOfTokens - 1].type == TOKEN_BACKGROUND) /* Only a & at the very end means anything. */
+	{
+		line->inBackground = 1;
+		numberOfTokens--;
+	}
+
+	if (error == NULL && numberOfTokens > 0)
+	{
+		line->numberOfCommands = 1;
+
+		for (token = 0; token < numberOfTokens; token++)
+		{
+			if (state.tokens[token].type == TOKEN_PIPE)
+			{
+				line->numberOfCommands++;
+			}
+		}
+
+		line->commands = arenaAllocate(line->numberOfCommands * sizeof(struct simpleCommand));
+	}
+
+	/* Each command runs from one | to the next. Its words are counted first, to size its argument list, and then copied in. */
+
+	for (token = 0, stage = 0; error == NULL && stage < line->numberOfCommands; stage++, token++)
+	{
+		struct simpleCommand *command = &line->commands[stage];
+		int stageStart = token;
+		int numberOfWords = 0;
+
+		for (; token < numberOfTokens && state.tokens[token].type != TOKEN_PIPE; token++)
+		{
+			if (state.tokens[token].type == TOKEN_BACKGROUND)
+			{
+				error = "& can only end a line";
+			}
+
+			else if (state.tokens[token].type != TOKEN_WORD) /* < or >, which have to be followed by a file name. */
+			{
+				if (token + 1 >= numberOfTokens || state.tokens[token + 1].type != TOKEN_WORD)
+				{
+					error = (state.tokens[token].type == TOKEN_INPUT) ? "missing file name after <" : "missing file name after >";
+				}
+				token++;
+			}
+
+			else
+			{
+				numberOfWords++;
+			}
+		}
+
+		if (error == NULL && numberOfWords == 0)
+		{
+			error = (line->numberOfCommands > 1) ? "missing command in pipeline" : "missing command";
+		}
+
+		if (error != NULL)
+		{
+			break;
+		}
+
+		command->arguments = arenaAllocate((numberOfWords + 1) * sizeof(char *));
+		command->numberOfArguments = 0;
+		command->inputFile = NULL;
+		command->outputFile = NULL;
+
+		for (token = stageStart; token < numberOfTokens && state.tokens[token].type != TOKEN_PIPE; token++)
+		{
+			if (state.tokens[token].type == TOKEN_INPUT)
+			{
+				command->inputFile = state.tokens[++token].word; /* A later < replaces an earlier one, as in other shells. */
+			}
+
+			else if (state.tokens[token].type == TOKEN_OUTPUT)
+			{
+				command->outputFile = state.tokens[++token].word;
+			}
+
+			else
+			{
+				command->arguments[command->numberOfArguments++] = state.tokens[token].word;
+			}
+		}
+
+		command->arguments[command->numberOfArguments] = NULL;
+	}
+
+	if (error != NULL)
+	{
+		fprintf(stderr, "smallsh: syntax error: %s\n", error);
+		line->numberOfCommands = 0;
+		syntaxErrors++;
+		return -1;
+	}
+
+	return 0;
+}
+
+/****************************
+**          int launchCommand(struct simpleCommand *command, int inBackground, int inputfd, int outputfd, pid_t *processID)
+** Description: Starts a command with posix_spawn instead of fork and execvp. The command is looked up in PATH once and
+** then remembered by resolveCommand(), so it is started straight from its full path. fork has to copy the page tables of the
+** shell for every command, while posix_spawn starts the child without copying anything, which adds up over thousands 
+** of small commands. The < and > files of the command are turned into file actions that the spawn carries out in the
+** child before the exec.
+** Foreground commands get the default action for SIGINT back, so CTRL-C interrupts them but not the shell. If inputfd
+** or outputfd is not -1, it becomes the standard input or output of the command, which is how pipeline stages are 
+** connected. A < or > on the same command still wins over the pipe. Returns 0 and stores the process id of the child in processID, or -1 if the command could not be started.
+****************************/
+
+int launchCommand(struct simpleCommand *command, int inBackground, int inputfd, int outputfd, pid_t *processID)
+{
+	posix_spawn_file_actions_t fileActions; /* The redirections to do in the child before the exec. */
+	posix_spawnattr_t attributes; /* Spawn attributes, used to reset SIGINT for foreground commands. */
+	sigset_t defaultSignals; /* The signals to reset to their default action in the child. */
+	char **commandArguments = command->arguments; /* The arguments handed to the command, which end with NULL. */
+	int error; /* Holds the result of posix_spawn. */
+	char *commandPath; /* Where the command is, from resolveCommand(). */
+
+	fflush(stdout); /* Whatever the shell printed has to come out before anything the command prints, even when standard output is fully buffered in script mode. */
+
+	posix_spawn_file_actions_init(&fileActions);
+
+	/* The pipe ends go first, so that a redirection later in the list replaces them. The pipes are opened close-on-exec, so the
+	   duplicated descriptors are the only pipe ends the command keeps. */
+
+	if (inputfd != -1)
+	{
+		posix_spawn_file_actions_adddup2(&fileActions, inputfd, STDIN_FILENO);
+	}
+
+	if (outputfd != -1)
+	{
+		posix_spawn_file_actions_adddup2(&fileActions, outputfd, STDOUT_FILENO);
+	}
+
+	if (command->inputFile != NULL) /* We need to redirect input.*/
+	{
+		if (access(command->inputFile, R_OK) == -1) /* If the file involved with redirection cannot be read,*/
+		{
+			printf("Cannot open %s to redirect input.\n", command->inputFile); /* Print so*/
+			fflush(stdout); /*flush for safety. */
+			posix_spawn_file_actions_destroy(&fileActions);
+			return -1;
+		}
+
+		posix_spawn_file_actions_addopen(&fileActions, STDIN_FILENO, command->inputFile, O_RDONLY, 0); /* Open the file as the standard input of the child.*/
+	}
+
+	if (command->outputFile != NULL) /* We need to redirect output, into a file that is created or truncated like creat() would.*/
+	{
+		posix_spawn_file_actions_addopen(&fileActions, STDOUT_FILENO, command->outputFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	}
+
+	posix_spawnattr_init(&attributes);
+
+	if (inBackground == 0)
+	{
+		sigemptyset(&defaultSignals);
+		sigaddset(&defaultSignals, SIGINT);
+		posix_spawnattr_setsigdefault(&attributes, &defaultSignals);
+		posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGDEF);
+	}
+
+	commandPath = resolveCommand(commandArguments[0]);
+	error = (commandPath != NULL) ? posix_spawn(processID, commandPath, &fileActions, &attributes, commandArguments, environ) : ENOENT;
+
+	/* If a remembered command has been moved or deleted since, forget where it was and look through PATH again, once. */
+
+	if (error == ENOENT && commandPath != NULL && strchr(commandArguments[0], '/') == NULL)
+	{
+		forgetCommand(commandArguments[0]);
+		commandPath = resolveCommand(commandArguments[0]);
+
+		if (commandPath != NULL)
+		{
+			error = posix_spawn(processID, commandPath, &fileActions, &attributes, commandArguments, environ);
+		}
+	}
+
+	posix_spawn_file_actions_destroy(&fileActions);
+	posix_spawnattr_destroy(&attributes);
+
+	if (error != 0) /* This point can only be reached with an error if the command could not be found or started. */
+	{
+		printf("Some error occured.\n");
+		fflush(stdout); /* Flush for safety*/
+		return -1;
+	}
+
+	return 0;
+}
+
+/****************************
+**                                      size_t commandSlot(char *name)
+** Description: Returns the slot of the command table where a command name starts looking, from the FNV-1a hash of the name.
+****************************/
+
+size_t commandSlot(char *name)
+{
+	size_t hash = 2166136261u;
+
+	for (; *name != '\0'; name++)
+	{
+		hash = (hash ^ (unsigned char)*name) * 16777619u;
+	}
+
+	return hash & (commandTableSize - 1);
+}
+
+/****************************
+**                                 struct hashedCommand *findCommand(char *name)
+** Description: Returns the remembered location of a command, or NULL if it is not in the command table.
+****************************/
+
+struct hashedCommand *findCommand(char *name)
+{
+	size_t slot;
+
+	if (commandCount == 0)
+	{
+		return NULL;
+	}
+
+	for (slot = commandSlot(name); commandTable[slot].name != NULL; slot = (slot + 1) & (commandTableSize - 1))
+	{
+		if (strcmp(commandTable[slot].name, name) == 0)
+		{
+			return &commandTable[slot];
+		}
+	}
+
+	return NULL;
+}
+
+/****************************
+**                                      char *resolveCommand(char *name)
+** Description: Returns the full path of a command, the same one execvp would end up running. Names with a / in them
+** are used as they are. Otherwise the command table is checked first, and only if the command is not there are the
+** directories of PATH searched for an executable file, which is then added to the table. Commands found through a
+** relative directory of PATH, like ".", are not remembered, since they change with the working directory. Returns
+** NULL if the command is nowhere in PATH. The returned string belongs to the table or a static buffer, so it is only
+** good until the next call.
+****************************/
+
+char *resolveCommand(char *name)
+{
+	static char candidate[4096]; /* Holds the full path being tried. */
+	char *path = getenv("PATH");
+	char *directory, *directoryEnd;
+	struct hashedCommand *command;
+	struct stat fileStatus;
+	size_t slot;
+
+	if (strchr(name, '/') != NULL)
+	{
+		return name;
+	}
+
+	if (path == NULL)
+	{
+		path = "/bin:/usr/bin"; /* The same default execvp uses. */
+	}
+
+	if (hashedPath == NULL || strcmp(hashedPath, path) != 0) /* A different PATH can find different commands, so start over. */
+	{
+		clearCommands();
+		free(hashedPath);
+		hashedPath = strdup(path);
+	}
+
+	command = findCommand(name);
+
+	if (command != NULL)
+	{
+		command->hits++;
+		return command->path;
+	}
+
+	for (directory = path; ; directory = directoryEnd + 1)
+	{
+		directoryEnd = strchr(directory, ':');
+		int directoryLength = (directoryEnd != NULL) ? (int)(directoryEnd - directory) : (int)strlen(directory);
+
+		/* An empty entry in PATH means the current directory. */
+
+		if (directoryLength == 0)
+		{
+			snprintf(candidate, sizeof(candidate), "./%s", name);
+		}
+
+		else
+		{
+			snprintf(candidate, sizeof(candidate), "%.*s/%s", directoryLength, directory, name);
+		}
+
+		if (stat(candidate, &fileStatus) == 0 && S_ISREG(fileStatus.st_mode) && access(candidate, X_OK) == 0)
+		{
+			break;
+		}
+
+		if (directoryEnd == NULL)
+		{
+			return NULL;
+		}
+	}
+
+	if (candidate[0] != '/')
+	{
+		return candidate;
+	}
+
+	if ((commandCount + 1) * 2 > commandTableSize) /* Keep the table at most half full, placing every command again in the bigger table. */
+	{
+		struct hashedCommand *oldTable = commandTable;
+		size_t oldSize = commandTableSize;
+		size_t oldSlot;
+
+		commandTableSize = (oldSize == 0) ? 64 : oldSize * 2;
+		commandTable = calloc(commandTableSize, sizeof(struct hashedCommand));
+
+		if (commandTable == NULL)
+		{
+			perror("smallsh: command table");
+			exit(1);
+		}
+
+		for (oldSlot = 0; oldSlot < oldSize; oldSlot++)
+		{
+			if (oldTable[oldSlot].name != NULL)
+			{
+				for (slot = commandSlot(oldTable[oldSlot].name); commandTable[slot].name != NULL; slot = (slot + 1) & (commandTableSize - 1));
+				commandTable[slot] = oldTable[oldSlot];
+			}
+		}
+
+		free(oldTable);
+	}
+
+	for (slot = commandSlot(name); commandTable[slot].name != NULL; slot = (slot + 1) & (commandTableSize - 1));
+
+	commandTable[slot].name = strdup(name);
+	commandTable[slot].path = strdup(candidate);
+	commandTable[slot].hits = 1;
+	commandCount++;
+
+	return commandTable[slot].path;
+}
+
+/****************************
+**                                      void forgetCommand(char *name)
+** Description: Takes one command out of the command table, moving the commands after it back into the hole the same
+** way removeJob() does.
+****************************/
+
+void forgetCommand(char *name)
+{
+	struct hashedCommand *command = findCommand(name);
+	size_t hole, slot;
+
+	if (command == NULL)
+	{
+		return;
+	}
+
+	free(command->name);
+	free(command->path);
+	command->name = NULL;
+	commandCount--;
+
+	for (hole = slot = command - commandTable; ; )
+	{
+		slot = (slot + 1) & (commandTableSize - 1);
+
+		if (commandTable[slot].name == NULL)
+		{
+			return;
+		}
+
+		size_t start = commandSlot(commandTable[slot].name);
+
+		if (((slot - start) & (commandTableSize - 1)) >= ((slot - hole) & (commandTableSize - 1)))
+		{
+			commandTable[hole] = commandTable[slot];
+			commandTable[slot].name = NULL;
+			hole = slot;
+		}
+	}
+}
+
+/****************************
+**                                          void clearCommands(void)
+** Description: Forgets every remembered command, like hash -r.
+****************************/
+
+void clearCommands(void)
+{
+	size_t slot;
+
+	for (slot = 0; slot < commandTableSize; slot++)
+	{
+		if (commandTable[slot].name != NULL)
+		{
+			free(commandTable[slot].name);
+			free(commandTable[slot].path);
+			commandTable[slot].name = NULL;
+		}
+	}
+
+	commandCount = 0;
+}
+
+/****************************
+**                         void runHash(char *commandArguments[], int numberOfArguments)
+** Description: Runs the hash built in. "hash" lists the remembered commands with how many times each was run, "hash -r"
+** forgets all of them, and "hash name ..." looks the names up in PATH and remembers them. Sets the status.
+****************************/
+
+void runHash(char *commandArguments[], int numberOfArguments)
+{
+	int argument;
+	size_t slot;
+
+	statusStatus = 0;
+
+	if (numberOfArguments == 1)
+	{
+		if (commandCount == 0)
+		{
+			printf("hash: hash table empty\n");
+		}
+
+		else
+		{
+			printf("hits\tcommand\n");
+
+			for (slot = 0; slot < commandTableSize; slot++)
+			{
+				if (commandTable[slot].name != NULL)
+				{
+					printf("%4lu\t%s\n", commandTable[slot].hits, commandTable[slot].path);
+				}
+			}
+		}
+	}
+
+	for (argument = 1; argument < numberOfArguments; argument++)
+	{
+		if (strcmp(commandArguments[argument], "-r") == 0)
+		{
+			clearCommands();
+		}
+
+		else if (findCommand(commandArguments[argument]) != NULL)
+		{
+			continue; /* Already remembered. */
+		}
+
+		else if (resolveCommand(commandArguments[argument]) == NULL)
+		{
+			printf("hash: %s: not found\n", commandArguments[argument]);
+			statusStatus = 1;
+		}
+
+		else
+		{
+			struct hashedCommand *command = findCommand(commandArguments[argument]);
+
+			if (command != NULL)
+			{
+				command->hits = 0; /* Only looking a command up does not count as running it. */
+			}
+		}
+	}
+
+	fflush(stdout);
+}
+
+/****************************
+**   void recordJob(pid_t processID, char *command, int inBackground, struct timespec *started, int status, struct rusage *usage)
+** Description: Keeps what a finished job used, from the rusage that wait4() handed back, in the list that jobs -v
+** prints. Only the last JOB_HISTORY jobs are kept, the oldest being written over. While the time built in is running,
+** what a foreground job used is also added to what time will print.
+****************************/
+
+void recordJob(pid_t processID, char *command, int inBackground, struct timespec *started, int status, struct rusage *usage)
+{
+	struct jobRecord *record = &finishedJobs[finishedJobCount % JOB_HISTORY];
+
+	record->processID = processID;
+	snprintf(record->command, sizeof(record->command), "%s", command);
+	record->inBackground = inBackground;
+	record->status = status;
+	record->wallTime = wallTimeOf(processID, started);
+	record->usage = *usage;
+	finishedJobCount++;
+
+	if (timeBuiltinRunning == 1 && inBackground == 0)
+	{
+		addTimes(&timedChildren.ru_utime, &usage->ru_utime);
+		addTimes(&timedChildren.ru_stime, &usage->ru_stime);
+
+		if (usage->ru_maxrss > timedChildren.ru_maxrss)
+		{
+			timedChildren.ru_maxrss = usage->ru_maxrss;
+		}
+
+		timedChildren.ru_nvcsw += usage->ru_nvcsw;
+		timedChildren.ru_nivcsw += usage->ru_nivcsw;
+	}
+}
+
+/****************************
+**                          void addTimes(struct timeval *total, struct timeval *amount)
+** Description: Adds one timeval to another, carrying the microseconds over into seconds.
+****************************/
+
+void addTimes(struct timeval *total, struct timeval *amount)
+{
+	total->tv_sec += amount->tv_sec;
+	total->tv_usec += amount->tv_usec;
+
+	if (total->tv_usec >= 1000000)
+	{
+		total->tv_sec++;
+		total->tv_usec -= 1000000;
+	}
+}
+
+/****************************
+**                                      void startTimeBuiltin(void)
+** Description: Starts the time built in, which is a prefix like "time command arguments". It notes the time and what
+** the shell itself has used so far, so that built in commands that run inside the shell are counted as well.
+****************************/
+
+void startTimeBuiltin(void)
+{
+	timeBuiltinRunning = 1;
+	clock_gettime(CLOCK_MONOTONIC, &timeBuiltinStart);
+	getrusage(RUSAGE_SELF, &timeBuiltinSelf);
+	memset(&timedChildren, 0, sizeof(timedChildren));
+}
+
+/****************************
+**                                      void finishTimeBuiltin(void)
+** Description: If the time built in was used on the line that just finished, prints to standard error how long it
+** took, the user and system time of the shell and every foreground process it waited for, the largest resident set
+** size among them, and how many context switches they made.
+****************************/
+
+void finishTimeBuiltin(void)
+{
+	struct rusage self;
+	long long wallTime;
+	long userTime, systemTime; /* In microseconds. */
+
+	if (timeBuiltinRunning == 0)
+	{
+		return;
+	}
+
+	timeBuiltinRunning = 0;
+	wallTime = nanosecondsSince(&timeBuiltinStart);
+	getrusage(RUSAGE_SELF, &self);
+
+	userTime = (self.ru_utime.tv_sec - timeBuiltinSelf.ru_utime.tv_sec) * 1000000L + (self.ru_utime.tv_usec - timeBuiltinSelf.ru_utime.tv_usec)
+		+ timedChildren.ru_utime.tv_sec * 1000000L + timedChildren.ru_utime.tv_usec;
+	systemTime = (self.ru_stime.tv_sec - timeBuiltinSelf.ru_stime.tv_sec) * 1000000L + (self.ru_stime.tv_usec - timeBuiltinSelf.ru_stime.tv_usec)
+		+ timedChildren.ru_stime.tv_sec * 1000000L + timedChildren.ru_stime.tv_usec;
+
+	fflush(stdout);
+	fprintf(stderr, "\nreal\t%.3fs\nuser\t%.3fs\nsys\t%.3fs\n", wallTime / 1e9, userTime / 1e6, systemTime / 1e6);
+	fprintf(stderr, "maxrss\t%ld KB\nctxsw\t%ld voluntary, %ld involuntary\n", timedChildren.ru_maxrss,
+		timedChildren.ru_nvcsw + (self.ru_nvcsw - timeBuiltinSelf.ru_nvcsw), timedChildren.ru_nivcsw + (self.ru_nivcsw - timeBuiltinSelf.ru_nivcsw));
+}
+
+/****************************
+**                                      void runJobs(int verbose)
+** Description: Runs the jobs built in. "jobs" lists the background processes that are still running. "jobs -v" also
+** shows how long they have been running, and then the last jobs that finished, foreground and background, with their
+** wall, user and system time in milliseconds, largest resident set size, voluntary and involuntary context switches,
+** and how they ended.
+****************************/
+
+void runJobs(int verbose)
+{
+	size_t slot;
+	long record;
+
+	for (slot = 0; slot < jobTableSize; slot++)
+	{
+		if (jobTable[slot].processID == 0)
+		{
+			continue;
+		}
+
+		if (verbose)
+		{
+			printf("[%d] running %10.1f ms  %s\n", jobTable[slot].processID, nanosecondsSince(&jobTable[slot].started) / 1e6, jobTable[slot].command);
+		}
+
+		else
+		{
+			printf("[%d] running  %s\n", jobTable[slot].processID, jobTable[slot].command);
+		}
+	}
+
+	if (verbose && finishedJobCount > 0)
+	{
+		printf("%7s %10s %9s %9s %9s %7s %7s %-10s %s\n", "pid", "wall ms", "user ms", "sys ms", "maxrss KB", "vol cs", "inv cs", "ended", "command");
+
+		for (record = (finishedJobCount > JOB_HISTORY) ? finishedJobCount - JOB_HISTORY : 0; record < finishedJobCount; record++)
+		{
+			struct jobRecord *job = &finishedJobs[record % JOB_HISTORY];
+			char ended[32];
+
+			if (WIFEXITED(job->status))
+			{
+				snprintf(ended, sizeof(ended), "exit %d", WEXITSTATUS(job->status));
+			}
+
+			else
+			{
+				snprintf(ended, sizeof(ended), "signal %d", WTERMSIG(job->status));
+			}
+
+			printf("%7d %10.1f %9.1f %9.1f %9ld %7ld %7ld %-10s %s%s\n", job->processID, job->wallTime / 1e6,
+				job->usage.ru_utime.tv_sec * 1e3 + job->usage.ru_utime.tv_usec / 1e3, job->usage.ru_stime.tv_sec * 1e3 + job->usage.ru_stime.tv_usec / 1e3,
+				job->usage.ru_maxrss, job->usage.ru_nvcsw, job->usage.ru_nivcsw, ended, job->command, job->inBackground ? " &" : "");
+		}
+	}
+
+	fflush(stdout);
+	statusStatus = 0;
+}
+
+/****************************
+**                          int runPipeline(struct commandLine *line, int inBackground)
+** Description: Runs a line like "a | b | c". Every stage is started before any of them is waited on, with a pipe 
+** between each pair of neighbouring stages. Normal commands are spawned with launchCommand(). splicecat and splicetee
+** can be stages as well, in which case a child is forked to run them, since a built in command cannot be exec'd. In 
+** the foreground, the shell waits for every stage, and the status is the one of the last stage, like other shells. In 
+** the background, every stage is added to the job table. Returns 0, or -1 if the pipeline was not started.
+****************************/
+
+int runPipeline(struct commandLine *line, int inBackground)
+{
+	pid_t *stageIDs = arenaAllocate(line->numberOfCommands * sizeof(pid_t)); /* Process ids of the stages that were started. */
+	char **stageNames = arenaAllocate(line->numberOfCommands * sizeof(char *)); /* The command of each stage. */
+	struct timespec started; /* When the pipeline started, for the wall time of its stages. */
+	struct rusage usage; /* What a stage used. */
+	int numberOfStages = 0; /* How many stages were started. */
+	int previousOutput = -1; /* Read end of the pipe coming from the previous stage, or -1 for the first stage. */
+	int pipefds[2]; /* The pipe between the current stage and the next one. */
+	int argument; /* Loop control variable. */
+	int status; /* Local status variable.*/
+
+	clock_gettime(CLOCK_MONOTONIC, &started);
+
+	for (argument = 0; argument < line->numberOfCommands; argument++)
+	{
+		struct simpleCommand *stage = &line->commands[argument];
+		int lastStage = (argument == line->numberOfCommands - 1);
+		int outputfd = -1;
+
+		if (!lastStage)
+		{
+			if (pipe2(pipefds, O_CLOEXEC) == -1)
+			{
+				perror("Could not create a pipe");
+				break;
+			}
+			outputfd = pipefds[1];
+		}
+
+		if (isDataBuiltin(stage->arguments[0])) /* Built in stages run in a forked child with the pipe ends as standard input and output. */
+		{
+			fflush(stdout); /* Otherwise the child would get a copy of anything still buffered and print it a second time. */
+			pid_t childID = fork();
+
+			if (childID == 0)
+			{
+				signal(SIGINT, inBackground ? SIG_IGN : SIG_DFL);
+				_exit(runDataBuiltin(stage, previousOutput != -1 ? previousOutput : STDIN_FILENO, outputfd != -1 ? outputfd : STDOUT_FILENO));
+			}
+
+			if (childID > 0)
+			{
+				stageNames[numberOfStages] = stage->arguments[0];
+				stageIDs[numberOfStages++] = childID;
+			}
+		}
+
+		else if (launchCommand(stage, inBackground, previousOutput, outputfd, &stageIDs[numberOfStages]) == 0)
+		{
+			stageNames[numberOfStages++] = stage->arguments[0];
+		}
+
+		/* The shell has no use for the pipe ends once the stages that use them have started. Closing them is what lets the next stage see
+		   the end of its input once the stage before it exits. */
+
+		if (previousOutput != -1)
+		{
+			close(previousOutput);
+		}
+
+		if (outputfd != -1)
+		{
+			close(outputfd);
+			previousOutput = pipefds[0];
+		}
+
+		else
+		{
+			previousOutput = -1;
+		}
+	}
+
+	if (previousOutput != -1) /* Only left open if the pipeline was cut short by an error. */
+	{
+		close(previousOutput);
+	}
+
+	if (numberOfStages == 0)
+	{
+		statusStatus = 1;
+		return -1;
+	}
+
+	for (argument = 0; argument < numberOfStages; argument++)
+	{
+		if (inBackground)
+		{
+			addJob(stageIDs[argument], stageNames[argument], &started);
+		}
+
+		else
+		{
+			wait4(stageIDs[argument], &status, 0, &usage); /* Wait for every stage, and keep the status of the last one. */
+			recordJob(stageIDs[argument], stageNames[argument], 0, &started, status, &usage);
+
+			if (WIFEXITED(status))
+			{
+				statusStatus = WEXITSTATUS(status);
+			}
+		}
+	}
+
+	if (inBackground)
+	{
+		printf("background pid is %d\n", stageIDs[numberOfStages - 1]); /* Like other shells, the last stage stands for the pipeline. */
+		fflush(stdout);
+	}
+
+	return 0;
+}
+
+/****************************
+**                                  int isDataBuiltin(char *command)
+** Description: Returns 1 if the command is one of the built in commands that move data, splicecat or splicetee.
+****************************/
+
+int isDataBuiltin(char *command)
+{
+	return strcmp(command, "splicecat") == 0 || strcmp(command, "splicetee") == 0;
+}
+
+/****************************
+**                 int runDataBuiltin(struct simpleCommand *command, int inputfd, int outputfd)
+** Description: Runs splicecat or splicetee, reading from inputfd and writing to outputfd unless < or > says otherwise.
+** "splicecat [file ...]" copies each file, or the input if there are none, to the output. "splicetee file ..." copies
+** the input to the output and to every file. Returns the exit status, 0 on success and 1 on any error.
+****************************/
+
+int runDataBuiltin(struct simpleCommand *command, int inputfd, int outputfd)
+{
+	char **commandArguments = command->arguments;
+	char **files = command->arguments + 1; /* The file arguments. */
+	int numberOfFiles = command->numberOfArguments - 1;
+	int openedInput = -1, openedOutput = -1; /* Files opened for < and >, closed at the end. */
+	int result = 0;
+	int argument;
+
+	if (command->inputFile != NULL)
+	{
+		openedInput = open(command->inputFile, O_RDONLY);
+		if (openedInput == -1)
+		{
+			printf("Cannot open %s to redirect input.\n", command->inputFile);
+			fflush(stdout);
+			result = 1;
+		}
+		inputfd = openedInput;
+	}
+
+	if (result == 0 && command->outputFile != NULL)
+	{
+		openedOutput = creat(command->outputFile, 0644);
+		if (openedOutput == -1)
+		{
+			printf("Cannot open %s to redirect output.\n", command->outputFile);
+			fflush(stdout);
+			result = 1;
+		}
+		outputfd = openedOutput;
+	}
+
+	fflush(stdout); /* Anything the shell printed has to go out before the data we write straight to the descriptor. */
+
+	/* If a redirection failed, result is already 1 and there is nothing to copy. */
+
+	if (result == 0 && strcmp(commandArguments[0], "splicecat") == 0)
+	{
+		if (numberOfFiles == 0)
+		{
+			result = moveData(inputfd, outputfd);
+		}
+
+		for (argument = 0; argument < numberOfFiles; argument++)
+		{
+			int filefd = open(files[argument], O_RDONLY);
+
+			if (filefd == -1)
+			{
+				printf("splicecat: cannot open %s\n", files[argument]);
+				fflush(stdout);
+				result = 1;
+				continue;
+			}
+
+			if (moveData(filefd, outputfd) != 0)
+			{
+				result = 1;
+			}
+			close(filefd);
+		}
+	}
+
+	else if (result == 0) /* splicetee */
+	{
+		int *filefds = malloc((numberOfFiles + 1) * sizeof(int)); /* One for each file, since a line has no limit on its arguments. */
+		struct stat inputStatus, outputStatus;
+		int count = 0;
+
+		if (filefds == NULL)
+		{
+			perror("splicetee");
+			numberOfFiles = 0; /* Nothing is opened, and the input is still copied to the output. */
+			result = 1;
+		}
+
+		for (argument = 0; argument < numberOfFiles; argument++)
+		{
+			filefds[count] = creat(files[argument], 0644);
+			if (filefds[count] == -1)
+			{
+				printf("splicetee: cannot open %s\n", files[argument]);
+				fflush(stdout);
+				result = 1;
+				continue;
+			}
+			count++;
+		}
+
+		fstat(inputfd, &inputStatus);
+		fstat(outputfd, &outputStatus);
+
+		if (count == 1 && S_ISFIFO(inputStatus.st_mode) && S_ISFIFO(outputStatus.st_mode))
+		{
+			/* Between two pipes, tee() copies what is waiting in the input pipe into the output pipe without consuming it, and splice() then moves
+			   the same data from the input pipe into the file. The data never passes through the shell. */
+
+			ssize_t copied;
+
+			/* If the file cannot take the data, it stays in the input pipe, and teeing it again would send it to the output twice, so both
+			   loops stop right there. */
+
+			while (result == 0 && (copied = tee(inputfd, outputfd, 65536, 0)) > 0)
+			{
+				while (copied > 0)
+				{
+					ssize_t moved = splice(inputfd, NULL, filefds[0], NULL, copied, SPLICE_F_MOVE);
+					if (moved <= 0)
+					{
+						result = 1;
+						break;
+					}
+					copied -= moved;
+				}
+			}
+
+			if (copied < 0)
+			{
+				result = 1;
+			}
+		}
+
+		else /* Anything else goes through a buffer, since tee() only works between pipes. */
+		{
+			char buffer[65536];
+			ssize_t bytesRead;
+
+			while ((bytesRead = read(inputfd, buffer, sizeof(buffer))) > 0)
+			{
+				if (write(outputfd, buffer, bytesRead) != bytesRead)
+				{
+					result = 1;
+				}
+
+				for (argument = 0; argument < count; argument++)
+				{
+					if (write(filefds[argument], buffer, bytesRead) != bytesRead)
+					{
+						result = 1;
+					}
+				}
+			}
+		}
+
+		for (argument = 0; argument < count; argument++)
+		{
+			close(filefds[argument]);
+		}
+
+		free(filefds);
+	}
+
+	if (openedInput != -1)
+	{
+		close(openedInput);
+	}
+
+	if (openedOutput != -1)
+	{
+		close(openedOutput);
+	}
+
+	return result;
+}
+
+/****************************
+**                                int moveData(int inputfd, int outputfd)
+** Description: Copies everything from inputfd to outputfd with as little copying as possible. splice() moves data in 
+** the kernel, but one side has to be a pipe. If neither is, sendfile() can still do it in the kernel when the input is
+** a regular file. Only if both fail, like for a terminal, the data goes through a buffer. Returns 0, or 1 on an error.
+****************************/
+
+int moveData(int inputfd, int outputfd)
+{
+	char buffer[65536];
+	ssize_t moved;
+
+	while ((moved = splice(inputfd, NULL, outputfd, NULL, 65536, SPLICE_F_MOVE)) > 0)
+	{
+		continue;
+	}
+
+	if (moved == 0)
+	{
+		return 0;
+	}
+
+	if (errno != EINVAL) /* EINVAL means neither side is a pipe, anything else is a real error. */
+	{
+		return 1;
+	}
+
+	while ((moved = sendfile(outputfd, inputfd, NULL, 65536)) > 0)
+	{
+		continue;
+	}
+
+	if (moved == 0)
+	{
+		return 0;
+	}
+
+	while ((moved = read(inputfd, buffer, sizeof(buffer))) > 0)
+	{
+		if (write(outputfd, buffer, moved) != moved)
+		{
+			return 1;
+		}
+	}
+
+	return moved < 0;
+}
+
+/****************************
+**                                  int isFileBuiltin(char *command)
+** Description: Returns 1 if the command is one of the file utilities the shell can run itself, echo, cat, test, [, ls
+** and wc, and it is allowed. They are all allowed unless SMALLSH_BUILTINS is set, in which case only the ones named
+** in it are, separated by spaces, commas or colons. Setting it to an empty string always runs the real programs.
+****************************/
+
+int isFileBuiltin(char *command)
+{
+	char *allowed = getenv("SMALLSH_BUILTINS");
+	size_t length = strlen(command);
+	char *found;
+
+	if (strcmp(command, "echo") != 0 && strcmp(command, "cat") != 0 && strcmp(command, "test") != 0 && strcmp(command, "[") != 0
+		&& strcmp(command, "ls") != 0 && strcmp(command, "wc") != 0)
+	{
+		return 0;
+	}
+
+	if (allowed == NULL)
+	{
+		return 1;
+	}
+
+	for (found = strstr(allowed, command); found != NULL; found = strstr(found + 1, command)) /* The name has to be a whole entry of the list. */
+	{
+		if ((found == allowed || strchr(" ,:", found[-1]) != NULL) && (found[length] == '\0' || strchr(" ,:", found[length]) != NULL))
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/****************************
+**                            void builtinWrite(const char *data, size_t length)
+** Description: Adds output of a file utility to builtinBuffer, writing the buffer out to builtinOutput whenever it
+** fills, so that a listing of many short lines still takes only a few write() calls.
+****************************/
+
+void builtinWrite(const char *data, size_t length)
+{
+	while (length > 0)
+	{
+		size_t room = sizeof(builtinBuffer) - builtinBuffered;
+		size_t amount = (length < room) ? length : room;
+
+		memcpy(builtinBuffer + builtinBuffered, data, amount);
+		builtinBuffered += amount;
+		data += amount;
+		length -= amount;
+
+		if (builtinBuffered == sizeof(builtinBuffer))
+		{
+			builtinFlush();
+		}
+	}
+}
+
+/****************************
+**                                          void builtinFlush(void)
+** Description: Writes out whatever output of a file utility is still in builtinBuffer.
+****************************/
+
+void builtinFlush(void)
+{
+	size_t written = 0;
+
+	while (written < builtinBuffered)
+	{
+		ssize_t result = write(builtinOutput, builtinBuffer + written, builtinBuffered - written);
+
+		if (result == -1 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (result <= 0)
+		{
+			break; /* Like a closed pipe. Whatever is left is thrown away. */
+		}
+
+		written += result;
+	}
+
+	builtinBuffered = 0;
+}
+
+/****************************
+**                          int runFileBuiltin(struct simpleCommand *command)
+** Description: Runs echo, cat, test, [, ls or wc inside the shell, after opening any < and > files. Only the common
+** forms of each are done here. When a command has an option that is not handled, nothing is printed and -1 is
+** returned before any file is touched, and the caller starts the real program instead, so the output is always what
+** the real program would have printed. Otherwise returns the exit status.
+****************************/
+
+int runFileBuiltin(struct simpleCommand *command)
+{
+	char *name = command->arguments[0];
+	int inputfd = STDIN_FILENO, outputfd = STDOUT_FILENO;
+	int openedInput = -1, openedOutput = -1; /* Files opened for < and >, closed at the end. */
+	int result;
+
+	/* The options are checked first, since running the real program instead is only possible before anything happened. */
+
+	if ((strcmp(name, "echo") == 0 && !echoSupported(command))
+		|| (strcmp(name, "cat") == 0 && !catSupported(command))
+		|| (strcmp(name, "ls") == 0 && !lsSupported(command))
+		|| (strcmp(name, "wc") == 0 && wcOptions(command) == -1))
+	{
+		return -1;
+	}
+
+	/* The shell ignores CTRL-C, so a cat or wc that would sit reading the keyboard is left to the real program, which CTRL-C can stop. */
+
+	if ((name[0] == 'c' || name[0] == 'w') && command->inputFile == NULL && isatty(STDIN_FILENO))
+	{
+		int argument, operands = 0;
+
+		for (argument = 1; argument < command->numberOfArguments; argument++)
+		{
+			if (strcmp(command->arguments[argument], "-") == 0)
+			{
+				return -1;
+			}
+			operands += (command->arguments[argument][0] != '-');
+		}
+
+		if (operands == 0)
+		{
+			return -1;
+		}
+	}
+
+	if (strcmp(name, "test") == 0 || strcmp(name, "[") == 0)
+	{
+		int numberOfOperands = command->numberOfArguments - 1;
+
+		if (name[0] == '[')
+		{
+			if (numberOfOperands == 0 || strcmp(command->arguments[numberOfOperands], "]") != 0)
+			{
+				return -1; /* Let the real [ complain about the missing ]. */
+			}
+			numberOfOperands--;
+		}
+
+		return evaluateTest(command->arguments + 1, numberOfOperands); /* test prints nothing, so there is nothing to redirect. */
+	}
+
+	if (command->inputFile != NULL)
+	{
+		openedInput = open(command->inputFile, O_RDONLY);
+		if (openedInput == -1)
+		{
+			printf("Cannot open %s to redirect input.\n", command->inputFile);
+			fflush(stdout);
+			return 1;
+		}
+		inputfd = openedInput;
+	}
+
+	if (command->outputFile != NULL)
+	{
+		openedOutput = creat(command->outputFile, 0644);
+		if (openedOutput == -1)
+		{
+			printf("Cannot open %s to redirect output.\n", command->outputFile);
+			fflush(stdout);
+			if (openedInput != -1)
+			{
+				close(openedInput);
+			}
+			return 1;
+		}
+		outputfd = openedOutput;
+	}
+
+	fflush(stdout); /* Anything the shell printed has to go out before the output we write straight to the descriptor. */
+	builtinOutput = outputfd;
+	builtinBuffered = 0;
+
+	if (strcmp(name, "echo") == 0)
+	{
+		result = runEcho(command);
+	}
+
+	else if (strcmp(name, "cat") == 0)
+	{
+		result = runCat(command, inputfd);
+	}
+
+	else if (strcmp(name, "ls") == 0)
+	{
+		result = runLs(command);
+	}
+
+	else
+	{
+		result = runWc(command, inputfd);
+	}
+
+	builtinFlush();
+
+	if (openedInput != -1)
+	{
+		close(openedInput);
+	}
+
+	if (openedOutput != -1)
+	{
+		close(openedOutput);
+	}
+
+	return result;
+}
+
+/****************************
+**                              int echoOptions(const char *word)
+** Description: Tells what a leading word of echo is, the way bash and coreutils read it. A word that is - and then only 
+** the letters n, e and E is options, anything else is the first word of the text. Returns 0 for text, 1 for options that
+** are all -n, and 2 for options with -e or -E in them.
+****************************/
+
+int echoOptions(const char *word)
+{
+	int onlyNewline = 1;
+
+	if (word[0] != '-' || word[1] == '\0')
+	{
+		return 0;
+	}
+
+	for (word++; *word != '\0'; word++)
+	{
+		if (*word != 'n' && *word != 'e' && *word != 'E')
+		{
+			return 0;
+		}
+
+		onlyNewline &= (*word == 'n');
+	}
+
+	return onlyNewline ? 1 : 2;
+}
+
+/****************************
+**                              int echoSupported(struct simpleCommand *command)
+** Description: echo is done here unless one of its leading options is something other than -n, like -e.
+****************************/
+
+int echoSupported(struct simpleCommand *command)
+{
+	int argument;
+
+	for (argument = 1; argument < command->numberOfArguments; argument++)
+	{
+		int options = echoOptions(command->arguments[argument]);
+
+		if (options != 1)
+		{
+			return options == 0;
+		}
+	}
+
+	return 1;
+}
+
+/****************************
+**                                     int runEcho(struct simpleCommand *command)
+** Description: Prints the arguments separated by spaces, and a newline unless there is a -n among the leading options.
+** echoSupported() has already made sure every leading option is -n.
+****************************/
+
+int runEcho(struct simpleCommand *command)
+{
+	int argument = 1;
+	int newline = 1;
+
+	while (argument < command->numberOfArguments && echoOptions(command->arguments[argument]) == 1)
+	{
+		newline = 0;
+		argument++;
+	}
+
+	for (; argument < command->numberOfArguments; argument++)
+	{
+		builtinWrite(command->arguments[argument], strlen(command->arguments[argument]));
+
+		if (argument + 1 < command->numberOfArguments)
+		{
+			builtinWrite(" ", 1);
+		}
+	}
+
+	if (newline)
+	{
+		builtinWrite("\n", 1);
+	}
+
+	return 0;
+}
+
+/****************************
+**                              int catSupported(struct simpleCommand *command)
+** Description: cat is done here when it has no options, only file names and - for the standard input.
+****************************/
+
+int catSupported(struct simpleCommand *command)
+{
+	int argument;
+
+	for (argument = 1; argument < command->numberOfArguments; argument++)
+	{
+		if (command->arguments[argument][0] == '-' && command->arguments[argument][1] != '\0')
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/****************************
+**                            int runCat(struct simpleCommand *command, int inputfd)
+** Description: Copies each file, or the input if there are none, to the output with moveData(), the same zero copy
+** path splicecat uses, so the file data never passes through the shell when splice() or sendfile() can move it.
+****************************/
+
+int runCat(struct simpleCommand *command, int inputfd)
+{
+	int argument;
+	int result = 0;
+
+	if (command->numberOfArguments == 1)
+	{
+		return moveData(inputfd, builtinOutput) != 0;
+	}
+
+	for (argument = 1; argument < command->numberOfArguments; argument++)
+	{
+		char *fileName = command->arguments[argument];
+		int filefd = (strcmp(fileName, "-") == 0) ? inputfd : open(fileName, O_RDONLY);
+
+		if (filefd == -1)
+		{
+			fprintf(stderr, "cat: %s: %s\n", fileName, strerror(errno));
+			result = 1;
+			continue;
+		}
+
+		if (moveData(filefd, builtinOutput) != 0)
+		{
+			fprintf(stderr, "cat: %s: %s\n", fileName, strerror(errno));
+			result = 1;
+		}
+
+		if (filefd != inputfd)
+		{
+			close(filefd);
+		}
+	}
+
+	return result;
+}
+
+/****************************
+**                          int evaluateTest(char *operands[], int numberOfOperands)
+** Description: Evaluates the operands of test or [ the way POSIX describes for up to four of them: a leading !
+** negates the rest, one operand is true if it is not empty, a unary file or string test with two, and a string or
+** integer comparison with three. Returns 0 for true and 1 for false, or -1 for anything else, like -a, -o,
+** parentheses or a number that is not one, so that the real test handles it and its error messages.
+****************************/
+
+int evaluateTest(char *operands[], int numberOfOperands)
+{
+	struct stat fileStatus;
+	char *operator;
+
+	/* With three operands, a binary operator in the middle comes before a leading !, so "test ! = x" compares two strings. */
+
+	int binary = numberOfOperands == 3 && (strcmp(operands[1], "=") == 0 || strcmp(operands[1], "==") == 0 || strcmp(operands[1], "!=") == 0
+		|| (operands[1][0] == '-' && strlen(operands[1]) == 3 && strstr("-eq-ne-lt-le-gt-ge", operands[1]) != NULL));
+
+	if (numberOfOperands > 1 && numberOfOperands <= 4 && strcmp(operands[0], "!") == 0 && !binary)
+	{
+		int result = evaluateTest(operands + 1, numberOfOperands - 1);
+		return (result == -1) ? -1 : !result;
+	}
+
+	if (numberOfOperands == 0)
+	{
+		return 1;
+	}
+
+	if (numberOfOperands == 1)
+	{
+		return operands[0][0] == '\0';
+	}
+
+	if (numberOfOperands == 2)
+	{
+		operator = operands[0];
+
+		if (strcmp(operator, "-z") == 0) return operands[1][0] != '\0';
+		if (strcmp(operator, "-n") == 0) return operands[1][0] == '\0';
+		if (strcmp(operator, "-r") == 0) return access(operands[1], R_OK) != 0;
+		if (strcmp(operator, "-w") == 0) return access(operands[1], W_OK) != 0;
+		if (strcmp(operator, "-x") == 0) return access(operands[1], X_OK) != 0;
+
+		if (strcmp(operator, "-e") != 0 && strcmp(operator, "-f") != 0 && strcmp(operator, "-d") != 0 && strcmp(operator, "-s") != 0)
+		{
+			return -1;
+		}
+
+		if (stat(operands[1], &fileStatus) == -1)
+		{
+			return 1;
+		}
+
+		if (operator[1] == 'f') return !S_ISREG(fileStatus.st_mode);
+		if (operator[1] == 'd') return !S_ISDIR(fileStatus.st_mode);
+		if (operator[1] == 's') return fileStatus.st_size == 0;
+		return 0;
+	}
+
+	if (binary)
+	{
+		operator = operands[1];
+
+		if (strcmp(operator, "=") == 0 || strcmp(operator, "==") == 0) return strcmp(operands[0], operands[2]) != 0;
+		if (strcmp(operator, "!=") == 0) return strcmp(operands[0], operands[2]) == 0;
+
+		if (operator[0] == '-' && strlen(operator) == 3)
+		{
+			char *end1, *end2;
+			long long left, right;
+
+			errno = 0;
+			left = strtoll(operands[0], &end1, 10);
+			right = strtoll(operands[2], &end2, 10);
+
+			if (errno != 0 || end1 == operands[0] || *end1 != '\0' || end2 == operands[2] || *end2 != '\0')
+			{
+				return -1;
+			}
+
+			if (strcmp(operator, "-eq") == 0) return !(left == right);
+			if (strcmp(operator, "-ne") == 0) return !(left != right);
+			if (strcmp(operator, "-lt") == 0) return !(left < right);
+			if (strcmp(operator, "-le") == 0) return !(left <= right);
+			if (strcmp(operator, "-gt") == 0) return !(left > right);
+			if (strcmp(operator, "-ge") == 0) return !(left >= right);
+		}
+	}
+
+	return -1;
+}
+
+/****************************
+**                               int lsSupported(struct simpleCommand *command)
+** Description: ls is done here with at most one file or directory, and only the -1, -a and -A options. Its output
+** also has to be one name per line, which is what ls prints when the output is not a terminal, or with -1.
+****************************/
+
+int lsSupported(struct simpleCommand *command)
+{
+	int argument;
+	int operands = 0;
+	int oneColumn = 0;
+
+	for (argument = 1; argument < command->numberOfArguments; argument++)
+	{
+		char *option = command->arguments[argument];
+
+		if (option[0] != '-' || option[1] == '\0')
+		{
+			operands++;
+			continue;
+		}
+
+		if (option[strspn(option + 1, "1aA") + 1] != '\0') /* Any other option letter, or a --long option. */
+		{
+			return 0;
+		}
+
+		if (strchr(option, '1') != NULL)
+		{
+			oneColumn = 1;
+		}
+	}
+
+	if (operands > 1)
+	{
+		return 0;
+	}
+
+	if (oneColumn == 0) /* Where the output goes decides the format, so look at it the way the command would see it. */
+	{
+		return command->outputFile != NULL || !isatty(STDOUT_FILENO);
+	}
+
+	return 1;
+}
+
+/****************************
+**                         int compareNames(const void *first, const void *second)
+** Description: Orders file names for ls, using the collation of the locale like ls does.
+****************************/
+
+int compareNames(const void *first, const void *second)
+{
+	return strcoll(*(char *const *)first, *(char *const *)second);
+}
+
+/****************************
+**                                      int runLs(struct simpleCommand *command)
+** Description: Lists a directory, the current one if none is given, one name per line in sorted order. Names that
+** start with a dot are left out unless -a, which shows . and .. as well, or -A, which does not. A file that is not a
+** directory is just printed. The names are kept in the parse arena, so nothing has to be freed afterwards.
+****************************/
+
+int runLs(struct simpleCommand *command)
+{
+	char *path = ".";
+	int showHidden = 0; /* 1 for -A, 2 for -a. */
+	int argument;
+	struct stat fileStatus;
+	DIR *directory;
+	struct dirent *entry;
+	char **names;
+	size_t numberOfNames = 0, nameCapacity = 256, name;
+
+	for (argument = 1; argument < command->numberOfArguments; argument++)
+	{
+		char *option = command->arguments[argument];
+
+		if (option[0] != '-' || option[1] == '\0')
+		{
+			path = option;
+		}
+
+		else if (strchr(option, 'a') != NULL)
+		{
+			showHidden = 2;
+		}
+
+		else if (strchr(option, 'A') != NULL && showHidden == 0)
+		{
+			showHidden = 1;
+		}
+	}
+
+	if (stat(path, &fileStatus) == -1)
+	{
+		fprintf(stderr, "ls: cannot access '%s': %s\n", path, strerror(errno));
+		return 2;
+	}
+
+	if (!S_ISDIR(fileStatus.st_mode))
+	{
+		builtinWrite(path, strlen(path));
+		builtinWrite("\n", 1);
+		return 0;
+	}
+
+	directory = opendir(path);
+
+	if (directory == NULL)
+	{
+		fprintf(stderr, "ls: cannot open directory '%s': %s\n", path, strerror(errno));
+		return 2;
+	}
+
+	names = arenaAllocate(nameCapacity * sizeof(char *));
+
+	while ((entry = readdir(directory)) != NULL)
+	{
+		if (entry->d_name[0] == '.')
+		{
+			int dotOrDotDot = entry->d_name[1] == '\0' || (entry->d_name[1] == '.' && entry->d_name[2] == '\0');
+
+			if (showHidden == 0 || (showHidden == 1 && dotOrDotDot))
+			{
+				continue;
+			}
+		}
+
+		if (numberOfNames == nameCapacity) /* The arena cannot grow an allocation, so move the names to one twice the size. */
+		{
+			char **moreNames = arenaAllocate(nameCapacity * 2 * sizeof(char *));
+			memcpy(moreNames, names, nameCapacity * sizeof(char *));
+			names = moreNames;
+			nameCapacity *= 2;
+		}
+
+		size_t length = strlen(entry->d_name) + 1;
+		names[numberOfNames] = arenaAllocate(length);
+		memcpy(names[numberOfNames++], entry->d_name, length);
+	}
+
+	closedir(directory);
+	qsort(names, numberOfNames, sizeof(char *), compareNames);
+
+	for (name = 0; name < numberOfNames; name++)
+	{
+		builtinWrite(names[name], strlen(names[name]));
+		builtinWrite("\n", 1);
+	}
+
+	return 0;
+}
+
+/****************************
+**                               int wcOptions(struct simpleCommand *command)
+** Description: Returns which counts wc should print, as WC_LINES, WC_WORDS and WC_BYTES added together, all three if
+** no option picks any. Returns -1 if there is an option other than -l, -w and -c, so the real wc runs instead.
+****************************/
+
+int wcOptions(struct simpleCommand *command)
+{
+	int counts = 0;
+	int argument;
+
+	for (argument = 1; argument < command->numberOfArguments; argument++)
+	{
+		char *option = command->arguments[argument];
+
+		if (option[0] != '-' || option[1] == '\0')
+		{
+			continue;
+		}
+
+		if (option[strspn(option + 1, "lwc") + 1] != '\0')
+		{
+			return -1;
+		}
+
+		counts |= (strchr(option, 'l') ? WC_LINES : 0) | (strchr(option, 'w') ? WC_WORDS : 0) | (strchr(option, 'c') ? WC_BYTES : 0);
+	}
+
+	return (counts == 0) ? (WC_LINES | WC_WORDS | WC_BYTES) : counts;
+}
+
+/****************************
+**        void countFile(int filefd, int counts, unsigned long long *lines, unsigned long long *words, unsigned long long *bytes)
+** Description: Counts the lines, words and bytes of what can be read from filefd. Only what was asked for is worked
+** out: the size of a regular file is enough for a byte count, and lines alone are counted with memchr(), which is
+** much faster than looking at every character.
+****************************/
+
+void countFile(int filefd, int counts, unsigned long long *lines, unsigned long long *words, unsigned long long *bytes)
+{
+	static char buffer[65536];
+	struct stat fileStatus;
+	ssize_t amount;
+	int inWord = 0;
+
+	*lines = *words = *bytes = 0;
+
+	if (counts == WC_BYTES && fstat(filefd, &fileStatus) == 0 && S_ISREG(fileStatus.st_mode))
+	{
+		*bytes = fileStatus.st_size;
+		return;
+	}
+
+	while ((amount = read(filefd, buffer, sizeof(buffer))) > 0)
+	{
+		*bytes += amount;
+
+		if ((counts & WC_WORDS) == 0)
+		{
+			char *position = buffer, *end = buffer + amount;
+
+			while ((position = memchr(position, '\n', end - position)) != NULL)
+			{
+				(*lines)++;
+				position++;
+			}
+			continue;
+		}
+
+		for (ssize_t character = 0; character < amount; character++)
+		{
+			unsigned char byte = buffer[character];
+
+			if (byte == '\n')
+			{
+				(*lines)++;
+			}
+
+			if (byte == ' ' || (byte >= '\t' && byte <= '\r'))
+			{
+				inWord = 0;
+			}
+
+			else if (inWord == 0)
+			{
+				inWord = 1;
+				(*words)++;
+			}
+		}
+	}
+}
+
+/****************************
+**       void printCounts(int counts, int width, unsigned long long lines, unsigned long long words, unsigned long long bytes, char *name)
+** Description: Prints one line of wc output, with each count right aligned in width columns and the name, if any.
+****************************/
+
+void printCounts(int counts, int width, unsigned long long lines, unsigned long long words, unsigned long long bytes, char *name)
+{
+	char line[256];
+	int length = 0;
+
+	if (counts & WC_LINES)
+	{
+		length += snprintf(line + length, sizeof(line) - length, "%s%*llu", length ? " " : "", width, lines);
+	}
+
+	if (counts & WC_WORDS)
+	{
+		length += snprintf(line + length, sizeof(line) - length, "%s%*llu", length ? " " : "", width, words);
+	}
+
+	if (counts & WC_BYTES)
+	{
+		length += snprintf(line + length, sizeof(line) - length, "%s%*llu", length ? " " : "", width, bytes);
+	}
+
+	builtinWrite(line, length);
+
+	if (name != NULL)
+	{
+		builtinWrite(" ", 1);
+		builtinWrite(name, strlen(name));
+	}
+
+	builtinWrite("\n", 1);
+}
+
+/****************************
+**                           int runWc(struct simpleCommand *command, int inputfd)
+** Description: Counts the lines, words and bytes of each file, or of the input if there are none, with a total line
+** when there is more than one file. The columns are as wide as GNU wc makes them: just wide enough for the total size
+** of the regular files, at least 7 when the input is not a regular file, and not padded at all for one count of one
+** file.
+****************************/
+
+int runWc(struct simpleCommand *command, int inputfd)
+{
+	int counts = wcOptions(command);
+	char **files = arenaAllocate(command->numberOfArguments * sizeof(char *));
+	int numberOfFiles = 0;
+	int width = 1, minimumWidth = 1;
+	int argument, file;
+	int result = 0;
+	unsigned long long regularTotal = 0;
+	unsigned long long totalLines = 0, totalWords = 0, totalBytes = 0;
+	struct stat fileStatus;
+
+	for (argument = 1; argument < command->numberOfArguments; argument++)
+	{
+		if (command->arguments[argument][0] != '-' || command->arguments[argument][1] == '\0')
+		{
+			files[numberOfFiles++] = command->arguments[argument];
+		}
+	}
+
+	if (numberOfFiles == 0)
+	{
+		if (fstat(inputfd, &fileStatus) == 0 && S_ISREG(fileStatus.st_mode))
+		{
+			regularTotal = fileStatus.st_size;
+		}
+
+		else
+		{
+			minimumWidth = 7;
+		}
+	}
+
+	for (file = 0; file < numberOfFiles; file++) /* Files that cannot be looked at do not count. */
+	{
+		int looked = (strcmp(files[file], "-") == 0) ? fstat(inputfd, &fileStatus) : stat(files[file], &fileStatus);
+
+		if (looked == 0 && S_ISREG(fileStatus.st_mode))
+		{
+			regularTotal += fileStatus.st_size;
+		}
+
+		else if (looked == 0)
+		{
+			minimumWidth = 7;
+		}
+	}
+
+	if (!((counts == WC_LINES || counts == WC_WORDS || counts == WC_BYTES) && numberOfFiles <= 1))
+	{
+		for (; regularTotal >= 10; regularTotal /= 10)
+		{
+			width++;
+		}
+
+		if (width < minimumWidth)
+		{
+			width = minimumWidth;
+		}
+	}
+
+	if (numberOfFiles == 0)
+	{
+		unsigned long long lines, words, bytes;
+		countFile(inputfd, counts, &lines, &words, &bytes);
+		printCounts(counts, width, lines, words, bytes, NULL);
+		return 0;
+	}
+
+	for (file = 0; file < numberOfFiles; file++)
+	{
+		unsigned long long lines, words, bytes;
+		int filefd = (strcmp(files[file], "-") == 0) ? inputfd : open(files[file], O_RDONLY);
+
+		if (filefd == -1)
+		{
+			builtinFlush(); /* Keep the error in order with the counts already printed. */
+			fprintf(stderr, "wc: %s: %s\n", files[file], strerror(errno));
+			result = 1;
+			continue;
+		}
+
+		countFile(filefd, counts, &lines, &words, &bytes);
+		printCounts(counts, width, lines, words, bytes, files[file]);
+		totalLines += lines;
+		totalWords += words;
+		totalBytes += bytes;
+
+		if (filefd != inputfd)
+		{
+			close(filefd);
+		}
+	}
+
+	if (numberOfFiles > 1)
+	{
+		printCounts(counts, width, totalLines, totalWords, totalBytes, "total");
+	}
+
+	return result;
+}
+
+/****************************
+**                                     void openScript(char *fileName)
+** Description: Maps the script file into memory and switches the shell into script mode. Standard output becomes fully
+** buffered, since nobody is waiting for a prompt. Exits if the file cannot be read. 
+****************************/
+
+void openScript(char *fileName)
+{
+	struct stat fileStatus;
+	int scriptfd = open(fileName, O_RDONLY);
+
+	if (scriptfd == -1 || fstat(scriptfd, &fileStatus) == -1)
+	{
+		perror("Cannot open script");
+		exit(1);
+	}
+
+	scriptSize = fileStatus.st_size;
+	scriptMode = 1;
+
+	if (scriptSize > 0) /* An empty file cannot be mapped, but it is a valid script that just does nothing. */
+	{
+		scriptData = mmap(NULL, scriptSize, PROT_READ, MAP_PRIVATE, scriptfd, 0);
+
+		if (scriptData == MAP_FAILED)
+		{
+			perror("Cannot map script");
+			exit(1);
+		}
+
+		madvise(scriptData, scriptSize, MADV_SEQUENTIAL); /* The file is read once from start to end. */
+	}
+
+	close(scriptfd); /* The mapping stays valid after the file is closed. */
+
+	setvbuf(stdout, NULL, _IOFBF, 65536);
+	clock_gettime(CLOCK_MONOTONIC, &scriptStart);
+}
+
+/****************************
+**                            long long nanosecondsSince(struct timespec *start)
+** Description: Returns how many nanoseconds have gone by since start. 
+****************************/
+
+long long nanosecondsSince(struct timespec *start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (long long)(now.tv_sec - start->tv_sec) * 1000000000LL + (now.tv_nsec - start->tv_nsec);
+}
+
+/****************************
+**                                    void finishCommandTiming(void)
+** Description: If a command of a script was being timed, adds its time to the statistics. 
+****************************/
+
+void finishCommandTiming(void)
+{
+	long long elapsed;
+
+	if (commandRunning == 0)
+	{
+		return;
+	}
+
+	elapsed = nanosecondsSince(&commandStart);
+	commandRunning = 0;
+	commandsTimed++;
+	totalCommandTime += elapsed;
+
+	if (shortestCommandTime == -1 || elapsed < shortestCommandTime)
+	{
+		shortestCommandTime = elapsed;
+	}
+
+	if (elapsed > longestCommandTime)
+	{
+		longestCommandTime = elapsed;
+		snprintf(slowestCommand, sizeof(slowestCommand), "%s", timedCommandName);
+	}
+}
+
+/****************************
+**                                       void reportTimings(void)
+** Description: When a script is done, prints the total wall time and the shortest, average, and longest command to 
+** standard error, so that it does not mix with the output of the script. 
+****************************/
+
+void reportTimings(void)
+{
+	if (scriptMode == 0)
+	{
+		return;
+	}
+
+	finishCommandTiming();
+	fflush(stdout);
+
+	fprintf(stderr, "smallsh: %ld commands in %.3f s wall time\n", commandsTimed, nanosecondsSince(&scriptStart) / 1e9);
+
+	if (commandsTimed > 0)
+	{
+		fprintf(stderr, "smallsh: per command min %.3f ms, avg %.3f ms, max %.3f ms (%s)\n", shortestCommandTime / 1e6,
+			totalCommandTime / 1e6 / commandsTimed, longestCommandTime / 1e6, slowestCommand);
+	}
+}
+
+/****************************
+**                      int growInputs(char ***inputs, size_t *inputCapacity)
+** Description: Doubles the array of parallel inputs. Returns 0, or -1 with a message if there is not enough memory, in
+** which case the array is left as it was for the caller to free.
+****************************/
+
+int growInputs(char ***inputs, size_t *inputCapacity)
+{
+	char **grown = realloc(*inputs, *inputCapacity * 2 * sizeof(char *));
+
+	if (grown == NULL)
+	{
+		perror("parallel");
+		return -1;
+	}
+
+	*inputs = grown;
+	*inputCapacity *= 2;
+	return 0;
+}
+
+/****************************
+**                              int runParallel(struct simpleCommand *command)
+** Description: Runs the parallel built in command. Up to the job limit, a command is started for each input, and as
+** soon as any of them finishes, the next one is started in its place. Exit values that are not 0 are reported as they
+** come in. Any < or > on the line applies to every job. Returns 0 if every job succeeded, and 1 otherwise, which
+** becomes the status.
+****************************/
+
+int runParallel(struct simpleCommand *command)
+{
+	char **commandArguments = command->arguments;
+	int numberOfArguments = command->numberOfArguments;
+	long jobLimit = sysconf(_SC_NPROCESSORS_ONLN); /* How many jobs may run at once, one per processor unless -j says otherwise. */
+	int templateStart = 1; /* Index of the first argument of the command to run. */
+	int templateLength; /* Number of arguments of the command, before the ::: or ::::. */
+	char **inputs; /* The inputs, one job each. */
+	size_t numberOfInputs = 0, inputCapacity = 64;
+	char *inputFileData = NULL; /* The contents of a :::: file, which the inputs point into. */
+	size_t nextInput = 0; /* Index of the next input to start a job for. */
+	pid_t *runningJobs; /* Process ids of the running jobs, 0 for a free slot. */
+	char **runningInputs; /* The input each running job was started for, to name it if it fails. */
+	struct timespec *runningStarts; /* When each running job was started. */
+	char **jobArguments; /* The command with the input filled in. One extra for an appended input, one for the NULL at the end. */
+	char **substituted; /* Arguments that had {} replaced, which have to be freed after the spawn. */
+	long running = 0; /* How many jobs are running. */
+	int failures = 0; /* How many jobs did not exit with 0. */
+	int argument, slot;
+
+	if (numberOfArguments > 2 && strcmp(commandArguments[1], "-j") == 0)
+	{
+		jobLimit = atol(commandArguments[2]);
+		templateStart = 3;
+	}
+
+	if (jobLimit < 1)
+	{
+		jobLimit = 1;
+	}
+
+	for (argument = templateStart; argument < numberOfArguments; argument++) /* Find where the command ends and the inputs begin. */
+	{
+		if (strcmp(commandArguments[argument], ":::") == 0 || strcmp(commandArguments[argument], "::::") == 0)
+		{
+			break;
+		}
+	}
+
+	templateLength = argument - templateStart;
+
+	/* There has to be a command, and either ::: or :::: with a file name after it. */
+
+	if (templateLength == 0 || argument == numberOfArguments || (strcmp(commandArguments[argument], "::::") == 0 && argument + 1 == numberOfArguments))
+	{
+		printf("usage: parallel [-j jobs] command [arguments] ::: input ... , or :::: file\n");
+		fflush(stdout);
+		return 1;
+	}
+
+	inputs = malloc(inputCapacity * sizeof(char *));
+
+	if (inputs == NULL)
+	{
+		perror("parallel");
+		return 1;
+	}
+
+	if (strcmp(commandArguments[argument], ":::") == 0) /* The inputs are the rest of the line. */
+	{
+		for (argument++; argument < numberOfArguments; argument++)
+		{
+			if (numberOfInputs == inputCapacity && growInputs(&inputs, &inputCapacity) == -1)
+			{
+				free(inputs);
+				return 1;
+			}
+			inputs[numberOfInputs++] = commandArguments[argument];
+		}
+	}
+
+	else /* The inputs are the lines of a file. */
+	{
+		FILE *inputFile = fopen(commandArguments[argument + 1], "r");
+		size_t dataLength = 0, dataCapacity = 65536;
+		char *line;
+
+		if (inputFile == NULL)
+		{
+			printf("parallel: cannot open %s\n", commandArguments[argument + 1]);
+			fflush(stdout);
+			free(inputs);
+			return 1;
+		}
+
+		/* Read the whole file into one buffer, then cut it into lines in place, so there are few allocations however many inputs there are.
+		   The buffer doubles as it fills rather than being sized up front, since the file may be a pipe, which has no size. */
+
+		inputFileData = malloc(dataCapacity + 1);
+
+		while (inputFileData != NULL)
+		{
+			dataLength += fread(inputFileData + dataLength, 1, dataCapacity - dataLength, inputFile);
+
+			if (dataLength < dataCapacity)
+			{
+				break;
+			}
+
+			char *grown = realloc(inputFileData, dataCapacity * 2 + 1);
+
+			if (grown == NULL)
+			{
+				free(inputFileData);
+			}
+			inputFileData = grown;
+			dataCapacity *= 2;
+		}
+
+		if (inputFileData == NULL)
+		{
+			perror("parallel");
+			fclose(inputFile);
+			free(inputs);
+			return 1;
+		}
+
+		if (ferror(inputFile))
+		{
+			printf("parallel: cannot read %s\n", commandArguments[argument + 1]);
+			fflush(stdout);
+			fclose(inputFile);
+			free(inputs);
+			free(inputFileData);
+			return 1;
+		}
+
+		inputFileData[dataLength] = '\0';
+		fclose(inputFile);
+
+		for (line = strtok(inputFileData, "\n"); line != NULL; line = strtok(NULL, "\n"))
+		{
+			if (numberOfInputs == inputCapacity && growInputs(&inputs, &inputCapacity) == -1)
+			{
+				free(inputs);
+				free(inputFileData);
+				return 1;
+			}
+			inputs[numberOfInputs++] = line;
+		}
+	}
+
+	runningJobs = calloc(jobLimit, sizeof(pid_t));
+	runningInputs = calloc(jobLimit, sizeof(char *));
+	runningStarts = calloc(jobLimit, sizeof(struct timespec));
+	jobArguments = malloc((templateLength + 2) * sizeof(char *));
+	substituted = malloc(templateLength * sizeof(char *));
+
+	if (runningJobs == NULL || runningInputs == NULL || runningStarts == NULL || jobArguments == NULL || substituted == NULL)
+	{
+		perror("parallel");
+		free(runningJobs);
+		free(runningInputs);
+		free(runningStarts);
+		free(jobArguments);
+		free(substituted);
+		free(inputs);
+		free(inputFileData);
+		return 1;
+	}
+
+	while (nextInput < numberOfInputs || running > 0)
+	{
+		/* Fill every free slot while there are inputs left. */
+
+		for (slot = 0; slot < jobLimit && nextInput < numberOfInputs; slot++)
+		{
+			int numberOfSubstituted = 0;
+			int usedPlaceholder = 0; /* 1 if any argument had a {}. */
+			int jobLength = 0;
+			char *input;
+
+			if (runningJobs[slot] != 0)
+			{
+				continue;
+			}
+
+			input = inputs[nextInput++];
+
+			for (argument = 0; argument < templateLength; argument++)
+			{
+				char *templateArgument = commandArguments[templateStart + argument];
+				char *placeholder = strstr(templateArgument, "{}");
+
+				if (placeholder == NULL)
+				{
+					jobArguments[jobLength++] = templateArgument;
+					continue;
+				}
+
+				/* Build the argument with the input in place of the {}. */
+
+				size_t prefixLength = placeholder - templateArgument;
+				char *filled = malloc(strlen(templateArgument) + strlen(input) + 1);
+
+				if (filled == NULL)
+				{
+					break;
+				}
+
+				memcpy(filled, templateArgument, prefixLength);
+				strcpy(filled + prefixLength, input);
+				strcat(filled, placeholder + 2);
+
+				jobArguments[jobLength++] = filled;
+				substituted[numberOfSubstituted++] = filled;
+				usedPlaceholder = 1;
+			}
+
+			if (usedPlaceholder == 0)
+			{
+				jobArguments[jobLength++] = input;
+			}
+
+			jobArguments[jobLength] = NULL;
+			clock_gettime(CLOCK_MONOTONIC, &runningStarts[slot]);
+
+			struct simpleCommand job = { jobArguments, jobLength, command->inputFile, command->outputFile };
+
+			if (argument < templateLength) /* An argument could not be filled in, so the job is not started and counts as failed. */
+			{
+				printf("parallel: job for %s not started: %s\n", input, strerror(ENOMEM));
+				fflush(stdout);
+				runningJobs[slot] = 0;
+				failures++;
+			}
+
+			else if (launchCommand(&job, 0, -1, -1, &runningJobs[slot]) == -1)
+			{
+				runningJobs[slot] = 0;
+				failures++;
+			}
+
+			else
+			{
+				runningInputs[slot] = input;
+				running++;
+			}
+
+			while (numberOfSubstituted > 0) /* The child has its own copy of the arguments once it is spawned. */
+			{
+				free(substituted[--numberOfSubstituted]);
+			}
+		}
+
+		if (running == 0)
+		{
+			continue; /* Nothing started, likely because the command could not be found. The loop ends once the inputs run out. */
+		}
+
+		/* Wait for whichever child finishes first. It might be an earlier background process instead of one of our jobs, in which case it
+		   is taken out of the job table and reported the same way checkProcesses() would have. */
+
+		int status;
+		struct rusage usage;
+		pid_t finished = wait4(-1, &status, 0, &usage);
+
+		if (finished == -1)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			break;
+		}
+
+		for (slot = 0; slot < jobLimit; slot++)
+		{
+			if (runningJobs[slot] == finished)
+			{
+				break;
+			}
+		}
+
+		if (slot == jobLimit)
+		{
+			struct job *job = findJob(finished);
+
+			if (job != NULL)
+			{
+				recordJob(finished, job->command, 1, &job->started, status, &usage);
+				removeJob(job);
+				reportBackgroundDone(finished, status);
+			}
+			continue;
+		}
+
+		recordJob(finished, commandArguments[templateStart], 0, &runningStarts[slot], status, &usage);
+		runningJobs[slot] = 0;
+		running--;
+
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		{
+			failures++;
+
+			if (WIFEXITED(status))
+			{
+				printf("parallel: job for %s exited with value %d\n", runningInputs[slot], WEXITSTATUS(status));
+			}
+
+			else
+			{
+				printf("parallel: job for %s terminated by signal %d\n", runningInputs[slot], WTERMSIG(status));
+			}
+			fflush(stdout);
+		}
+	}
+
+	printf("parallel: %zu jobs, %d failed\n", numberOfInputs, failures);
+	fflush(stdout);
+
+	free(runningJobs);
+	free(runningInputs);
+	free(runningStarts);
+	free(jobArguments);
+	free(substituted);
+	free(inputs);
+	free(inputFileData);
+
+	return failures > 0;
+}
+
+/****************************
+**                                          void openHistory(void)
+** Description: Opens the history file, $SMALLSH_HISTFILE or ~/.smallsh_history, creating it with its header if it is
+** new, maps it, and builds historyOffsets by hopping from one record header to the next, which is one pass over the
+** headers and nothing else, so even millions of entries load quickly. A record cut off at the end, from a shell that
+** died while writing it, is truncated away so that new records line up again. If anything is wrong with the file,
+** the shell runs without history.
+****************************/
+
+void openHistory(void)
+{
+	char fileName[4096];
+	char *setName = getenv("SMALLSH_HISTFILE");
+	char *home = getenv("HOME");
+	struct stat fileStatus;
+	size_t offset;
+
+	if (setName != NULL)
+	{
+		snprintf(fileName, sizeof(fileName), "%s", setName);
+	}
+
+	else if (home != NULL)
+	{
+		snprintf(fileName, sizeof(fileName), "%s/.smallsh_history", home);
+	}
+
+	else
+	{
+		return;
+	}
+
+	historyfd = open(fileName, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+
+	if (historyfd == -1 || fstat(historyfd, &fileStatus) == -1)
+	{
+		return;
+	}
+
+	if (fileStatus.st_size == 0 && write(historyfd, HISTORY_MAGIC, HISTORY_HEADER_SIZE) == HISTORY_HEADER_SIZE)
+	{
+		fileStatus.st_size = HISTORY_HEADER_SIZE;
+	}
+
+	if (mapHistory(fileStatus.st_size) == -1 || fileStatus.st_size < HISTORY_HEADER_SIZE || memcmp(historyMap, HISTORY_MAGIC, HISTORY_HEADER_SIZE) != 0)
+	{
+		fprintf(stderr, "smallsh: %s is not a history file, history is off.\n", fileName);
+		close(historyfd);
+		historyfd = -1;
+		return;
+	}
+
+	for (offset = HISTORY_HEADER_SIZE; offset + sizeof(struct historyRecord) <= historyMapSize; )
+	{
+		struct historyRecord *record = (struct historyRecord *)(historyMap + offset);
+		size_t recordSize = HISTORY_RECORD_SIZE(record->length);
+
+		if (recordSize > historyMapSize - offset)
+		{
+			break;
+		}
+
+		addHistoryOffset(offset);
+		offset += recordSize;
+	}
+
+	if (offset != historyMapSize) /* Throw away a record that was only partly written. */
+	{
+		if (ftruncate(historyfd, offset) == -1)
+		{
+			close(historyfd);
+			historyfd = -1;
+			return;
+		}
+		historyMapSize = offset;
+	}
+
+	historyEnabled = 1;
+}
+
+/****************************
+**                                      int mapHistory(size_t size)
+** Description: Maps the first size bytes of the history file, in place of any earlier mapping. The mapping is read
+** only. Records are only ever added with write(), so the mapping just has to be made again when it does not reach
+** far enough. Returns 0, or -1 if the file could not be mapped.
+****************************/
+
+int mapHistory(size_t size)
+{
+	if (historyMap != NULL)
+	{
+		munmap(historyMap, historyMapSize);
+		historyMap = NULL;
+	}
+
+	historyMapSize = size;
+
+	if (size == 0)
+	{
+		return 0;
+	}
+
+	historyMap = mmap(NULL, size, PROT_READ, MAP_SHARED, historyfd, 0);
+
+	if (historyMap == MAP_FAILED)
+	{
+		historyMap = NULL;
+		historyMapSize = 0;
+		return -1;
+	}
+
+	return 0;
+}
+
+/****************************
+**                                  void addHistoryOffset(size_t offset)
+** Description: Adds the offset of a record to the end of historyOffsets, doubling the array when it is full.
+****************************/
+
+void addHistoryOffset(size_t offset)
+{
+	if (historyCount == historyCapacity)
+	{
+		historyCapacity = (historyCapacity == 0) ? 1024 : historyCapacity * 2;
+		historyOffsets = realloc(historyOffsets, historyCapacity * sizeof(size_t));
+
+		if (historyOffsets == NULL)
+		{
+			perror("smallsh: history");
+			exit(1);
+		}
+	}
+
+	historyOffsets[historyCount++] = offset;
+}
+
+/****************************
+**                              struct historyRecord *historyEntry(size_t entry)
+** Description: Returns the record of an entry, numbered from 0, mapping the file again first if the entry was
+** written after the file was mapped.
+****************************/
+
+struct historyRecord *historyEntry(size_t entry)
+{
+	size_t offset = historyOffsets[entry];
+
+	if (offset + sizeof(struct historyRecord) > historyMapSize
+		|| offset + HISTORY_RECORD_SIZE(((struct historyRecord *)(historyMap + offset))->length) > historyMapSize)
+	{
+		struct stat fileStatus;
+		fstat(historyfd, &fileStatus);
+		mapHistory(fileStatus.st_size);
+	}
+
+	return (struct historyRecord *)(historyMap + offset);
+}
+
+/****************************
+**    void appendHistory(char *text, size_t length, long long startTime, long long duration, int exitStatus)
+** Description: Adds a record to the end of the history file with a single writev(), the header, the text and the
+** padding that keeps the next header aligned. O_APPEND makes the write land at the end even if another shell has
+** added records since, and the new offset is taken from where the write ended. If the sorted index has been built,
+** the entry is inserted into it as well.
+****************************/
+
+void appendHistory(char *text, size_t length, long long startTime, long long duration, int exitStatus)
+{
+	struct historyRecord record;
+	struct iovec pieces[3];
+	static char padding[8];
+	size_t recordSize = HISTORY_RECORD_SIZE(length);
+	ssize_t written;
+	off_t end;
+
+	record.startTime = startTime;
+	record.duration = duration;
+	record.exitStatus = exitStatus;
+	record.length = length;
+
+	pieces[0].iov_base = &record;
+	pieces[0].iov_len = sizeof(record);
+	pieces[1].iov_base = text;
+	pieces[1].iov_len = length;
+	pieces[2].iov_base = padding;
+	pieces[2].iov_len = recordSize - sizeof(record) - length;
+
+	written = writev(historyfd, pieces, 3);
+	end = lseek(historyfd, 0, SEEK_CUR);
+
+	if (written != (ssize_t)recordSize || end == -1)
+	{
+		return;
+	}
+
+	addHistoryOffset(end - recordSize);
+
+	if (historySorted != NULL) /* Keep the sorted index sorted, by moving everything after the new entry over by one. */
+	{
+		size_t position = findHistoryPrefix(text, length);
+
+		while (position < historySortedCount && compareHistoryText(historyEntry(historySorted[position]), text, length) == 0)
+		{
+			position++;
+		}
+
+		if (historySortedCount == historySortedCapacity)
+		{
+			historySortedCapacity *= 2;
+			historySorted = realloc(historySorted, historySortedCapacity * sizeof(size_t));
+
+			if (historySorted == NULL)
+			{
+				perror("smallsh: history");
+				exit(1);
+			}
+		}
+
+		memmove(historySorted + position + 1, historySorted + position, (historySortedCount - position) * sizeof(size_t));
+		historySorted[position] = historyCount - 1;
+		historySortedCount++;
+	}
+}
+
+/****************************
+**                                         void startHistoryEntry(void)
+** Description: Notes when the line that is about to run started, on the clock of the wall for the record and on the
+** monotonic clock for its duration.
+****************************/
+
+void startHistoryEntry(void)
+{
+	struct timespec now;
+
+	if (historyEnabled == 0)
+	{
+		return;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	historyStartTime = (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+	clock_gettime(CLOCK_MONOTONIC, &historyStart);
+	historyPending = 1;
+}
+
+/****************************
+**                                        void finishHistoryEntry(void)
+** Description: Once a line is done, adds it to the history with how long it took and the status it left. inputLine
+** still holds the line at this point, since the next one has not been read yet.
+****************************/
+
+void finishHistoryEntry(void)
+{
+	if (historyPending == 0)
+	{
+		return;
+	}
+
+	historyPending = 0;
+	appendHistory(inputLine, inputLength, historyStartTime, nanosecondsSince(&historyStart), statusStatus);
+}
+
+/****************************
+**           int compareHistoryText(struct historyRecord *record, const char *text, size_t length)
+** Description: Compares the text of a record with other text the way strcmp would, for the sorted index.
+****************************/
+
+int compareHistoryText(struct historyRecord *record, const char *text, size_t length)
+{
+	size_t shorter = (record->length < length) ? record->length : length;
+	int result = memcmp(record->text, text, shorter);
+
+	if (result != 0)
+	{
+		return result;
+	}
+
+	return (record->length > length) - (record->length < length);
+}
+
+/****************************
+**                      int compareHistoryEntries(const void *first, const void *second)
+** Description: Orders entry numbers by their text, and by when they were run when the text is the same.
+****************************/
+
+int compareHistoryEntries(const void *first, const void *second)
+{
+	size_t firstEntry = *(const size_t *)first, secondEntry = *(const size_t *)second;
+	struct historyRecord *secondRecord = historyEntry(secondEntry);
+	int result = compareHistoryText(historyEntry(firstEntry), secondRecord->text, secondRecord->length);
+
+	return (result != 0) ? result : (firstEntry > secondEntry) - (firstEntry < secondEntry);
+}
+
+/****************************
+**                               size_t findHistoryPrefix(const char *prefix, size_t length)
+** Description: Returns the position in the sorted index of the first entry whose text is not less than prefix, which
+** is where the entries starting with prefix begin, if there are any. The sorted index is built the first time it is
+** needed, so starting the shell never pays for the sort.
+****************************/
+
+size_t findHistoryPrefix(const char *prefix, size_t length)
+{
+	size_t low = 0, high;
+
+	if (historySorted == NULL)
+	{
+		size_t entry;
+
+		historySortedCapacity = (historyCount < 1024) ? 1024 : historyCount * 2;
+		historySorted = malloc(historySortedCapacity * sizeof(size_t));
+
+		if (historySorted == NULL)
+		{
+			perror("smallsh: history");
+			exit(1);
+		}
+
+		for (entry = 0; entry < historyCount; entry++)
+		{
+			historySorted[entry] = entry;
+		}
+
+		historySortedCount = historyCount;
+
+		if (historyCount > 0)
+		{
+			historyEntry(historyCount - 1); /* Map everything once, instead of while sorting. */
+		}
+		qsort(historySorted, historySortedCount, sizeof(size_t), compareHistoryEntries);
+	}
+
+	for (high = historySortedCount; low < high; )
+	{
+		size_t middle = low + (high - low) / 2;
+
+		if (compareHistoryText(historyEntry(historySorted[middle]), prefix, length) < 0)
+		{
+			low = middle + 1;
+		}
+
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+/****************************
+**                     int startsWith(struct historyRecord *record, const char *prefix, size_t length)
+** Description: Returns 1 if the text of the record begins with prefix.
+****************************/
+
+int startsWith(struct historyRecord *record, const char *prefix, size_t length)
+{
+	return record->length >= length && memcmp(record->text, prefix, length) == 0;
+}
+
+/****************************
+**                                          int expandHistory(void)
+** Description: Replaces a line starting with ! by an earlier line, like other shells do: !! is the last line, !N is
+** entry N, and !text is the last line that started with text, found through the sorted index. The line that will
+** run is printed first. Returns 0, or -1 if there is no such line, in which case the line is emptied.
+****************************/
+
+int expandHistory(void)
+{
+	struct historyRecord *record = NULL;
+	char *wanted = inputLine + 1;
+	size_t wantedLength = inputLength - 1;
+	size_t digits = 0;
+
+	while (digits < wantedLength && wanted[digits] >= '0' && wanted[digits] <= '9')
+	{
+		digits++;
+	}
+
+	if (wantedLength > 0 && wanted[0] == '!' && historyCount > 0)
+	{
+		record = historyEntry(historyCount - 1);
+	}
+
+	else if (wantedLength > 0 && digits == wantedLength)
+	{
+		size_t entry = 0;
+
+		for (digits = 0; digits < wantedLength; digits++)
+		{
+			entry = entry * 10 + (wanted[digits] - '0');
+		}
+
+		if (entry >= 1 && entry <= historyCount)
+		{
+			record = historyEntry(entry - 1);
+		}
+	}
+
+	else if (wantedLength > 0)
+	{
+		size_t position = findHistoryPrefix(wanted, wantedLength);
+		size_t latest = 0;
+		int found = 0;
+
+		for (; position < historySortedCount && startsWith(historyEntry(historySorted[position]), wanted, wantedLength); position++)
+		{
+			if (found == 0 || historySorted[position] > latest)
+			{
+				latest = historySorted[position];
+				found = 1;
+			}
+		}
+
+		if (found)
+		{
+			record = historyEntry(latest);
+		}
+	}
+
+	if (record == NULL)
+	{
+		fprintf(stderr, "smallsh: %.*s: event not found\n", (int)inputLength, inputLine);
+		inputLength = 0;
+		return -1;
+	}
+
+	if (inputCapacity < record->length + 1)
+	{
+		inputCapacity = record->length + 1;
+		inputBuffer = realloc(inputBuffer, inputCapacity);
+
+		if (inputBuffer == NULL)
+		{
+			perror("smallsh: history");
+			exit(1);
+		}
+	}
+
+	memcpy(inputBuffer, record->text, record->length);
+	inputLine = inputBuffer;
+	inputLength = record->length;
+	printf("%.*s\n", (int)inputLength, inputLine);
+	fflush(stdout);
+	return 0;
+}
+
+/****************************
+**                                       void printHistoryEntry(size_t entry)
+** Description: Prints one history entry: its number, when it was run, how long it took, its status and the line.
+****************************/
+
+void printHistoryEntry(size_t entry)
+{
+	struct historyRecord *record = historyEntry(entry);
+	time_t started = record->startTime / 1000000000LL;
+	char when[32];
+
+	strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&started));
+	printf("%6zu  %s %10.3f s  exit %-3d  %.*s\n", entry + 1, when, record->duration / 1e9, record->exitStatus, (int)record->length, record->text);
+}
+
+/****************************
+**                               void runHistory(struct simpleCommand *command)
+** Description: Runs the history built in. "history" lists every entry and "history N" the last N. "history -p text"
+** lists the entries that start with text, in the order they were run. "history -t [N]" adds up the time of the runs of
+** each line, and lists the N, 10 by default, that took the most time in total, to show where the time goes. Lines with
+** the same text are next to each other in the sorted index, so this is one pass over it.
+****************************/
+
+void runHistory(struct simpleCommand *command)
+{
+	char **arguments = command->arguments;
+	size_t entry;
+
+	statusStatus = 0;
+
+	if (historyEnabled == 0)
+	{
+		printf("history: history is off\n");
+		fflush(stdout);
+		statusStatus = 1;
+		return;
+	}
+
+	if (command->numberOfArguments > 2 && strcmp(arguments[1], "-p") == 0)
+	{
+		char *prefix = arguments[2];
+		size_t length, position, last;
+		size_t *matches;
+		int argument;
+
+		for (argument = 3; argument < command->numberOfArguments; argument++) /* The words after -p are put back together with spaces. */
+		{
+			char *joined = arenaAllocate(strlen(prefix) + strlen(arguments[argument]) + 2);
+
+			sprintf(joined, "%s %s", prefix, arguments[argument]);
+			prefix = joined;
+		}
+
+		length = strlen(prefix);
+		position = findHistoryPrefix(prefix, length);
+		last = position;
+
+		while (last < historySortedCount && startsWith(historyEntry(historySorted[last]), prefix, length))
+		{
+			last++;
+		}
+
+		matches = arenaAllocate((last - position) * sizeof(size_t) + 1);
+		memcpy(matches, historySorted + position, (last - position) * sizeof(size_t));
+		qsort(matches, last - position, sizeof(size_t), compareEntryNumbers); /* Back in the order they were run. */
+
+		for (entry = 0; entry < last - position; entry++)
+		{
+			printHistoryEntry(matches[entry]);
+		}
+	}
+
+	else if (command->numberOfArguments > 1 && strcmp(arguments[1], "-t") == 0)
+	{
+		long top = (command->numberOfArguments > 2) ? atol(arguments[2]) : 10;
+		struct historyTotal *totals;
+		size_t numberOfTotals = 0, position, total;
+
+		findHistoryPrefix("", 0); /* Only to make sure the sorted index is built. */
+		totals = arenaAllocate(historySortedCount * sizeof(struct historyTotal) + 1);
+
+		for (position = 0; position < historySortedCount; position++)
+		{
+			struct historyRecord *record = historyEntry(historySorted[position]);
+
+			if (numberOfTotals == 0 || compareHistoryText(historyEntry(totals[numberOfTotals - 1].entry), record->text, record->length) != 0)
+			{
+				totals[numberOfTotals].entry = historySorted[position];
+				totals[numberOfTotals].runs = 0;
+				totals[numberOfTotals].time = 0;
+				numberOfTotals++;
+			}
+
+			totals[numberOfTotals - 1].runs++;
+			totals[numberOfTotals - 1].time += record->duration;
+		}
+
+		qsort(totals, numberOfTotals, sizeof(struct historyTotal), compareTotals);
+		printf("%12s %6s %12s  %s\n", "total s", "runs", "average s", "command");
+
+		for (total = 0; total < numberOfTotals && (long)total < top; total++)
+		{
+			struct historyRecord *record = historyEntry(totals[total].entry);
+
+			printf("%12.3f %6lu %12.3f  %.*s\n", totals[total].time / 1e9, totals[total].runs, totals[total].time / 1e9 / totals[total].runs,
+				(int)record->length, record->text);
+		}
+	}
+
+	else
+	{
+		size_t first = 0;
+
+		if (command->numberOfArguments > 1)
+		{
+			size_t last = strtoul(arguments[1], NULL, 10);
+			first = (last < historyCount) ? historyCount - last : 0;
+		}
+
+		for (entry = first; entry < historyCount; entry++)
+		{
+			printHistoryEntry(entry);
+		}
+	}
+
+	fflush(stdout);
+}
+
+/****************************
+**                          int compareEntryNumbers(const void *first, const void *second)
+** Description: Orders entry numbers from the oldest to the newest.
+****************************/
+
+int compareEntryNumbers(const void *first, const void *second)
+{
+	size_t firstEntry = *(const size_t *)first, secondEntry = *(const size_t *)second;
+
+	return (firstEntry > secondEntry) - (firstEntry < secondEntry);
+}
+
+/****************************
+**                              int compareTotals(const void *first, const void *second)
+** Description: Orders the totals of history -t from the most time to the least.
+****************************/
+
+int compareTotals(const void *first, const void *second)
+{
+	long long firstTime = ((const struct historyTotal *)first)->time, secondTime = ((const struct historyTotal *)second)->time;
+
+	return (firstTime < secondTime) - (firstTime > secondTime);
 }
@@ -24,6 +24,7 @@
 #include <fcntl.h> /* Used for opening files in read and write modes. */
 
 #include <netinet/in.h> /* Included for IP address macro manipulation.*/
+#include <netinet/tcp.h> /* Provides TCP_NODELAY. */
 #include <arpa/inet.h> /* Included for IP address macro manipulation. */
 #include <netdb.h> /* Provides defintions for network data operations. */
 
@@ -31,6 +32,8 @@
 #include <signal.h> /* Needed for almost everything to do with sigaction, including the structure, and various signal set related options. */
 #include <stdbool.h> /* Includes a macro that expands true to 1 and false to 0. Just for self-documentation purposes primarily.  */
 
+#include "otp.h" /* Input validation and whole-buffer socket reads and writes, shared with the server. */
+
 /* The behavior of the client program differs based on if it is encrypting or decrypting. In the abscence of polymorphic object oriented behavior,
 we can simulate this by how it is defined. Defining it as ENCRYPT or DECRYPT changes the server type to either 'e' for encrypt or 'd' for decrypt. */
 
@@ -41,38 +44,71 @@ we can simulate this by how it is defined. Defining it as ENCRYPT or DECRYPT cha
 #endif
 
 /* Forward declare the two functions through prototypes. The two functions being processMessage() and sendMessage(). */
-void processMessage(char *port, char *messageFile, char *keyFile);
-void sendMessage(char *port, char *messageBuffer, char *keyBuffer,size_t messageLength);
+void processMessage(char *port, char *messageFile, char *keyFile, unsigned char options);
+void sendMessage(char *port, char *messageBuffer, char *keyBuffer, size_t messageLength, unsigned char options);
+
+/* verboseTransfer is set by the -v flag. The client then prints how many bytes it sent and received on the socket. */
 
-/* The client program processes 4 arguments. 
+bool verboseTransfer = false;
+
+/* The client program processes 4 arguments, plus optional flags after them. 
 Argument #1: The name of the program.
 Argument #2: Plaintext file
 Argument #3: Key file
-Argument #4: Port number to connect to. */
+Argument #4: Port number to connect to. 
+Flags: -p asks the server for the packed 5 bit wire format, -z asks for the plaintext to be sent compressed,
+and -v prints how many bytes went over the wire to stderr. */
 
 int main(int argc, char *argv[]) 
 {
-	/* If there isn't exactly 4 parameters, something is wrong. */
-	if (argc != 4) 
+	unsigned char options = 0; /* OPTION_ bits to ask the server for. */
+	int i; /* Loop control variable. */
+
+	/* If there are less than 4 parameters, something is wrong. */
+	if (argc < 4) 
 	{
-		fprintf(stderr, "Improper syntax. Try the following: Program_name plaintext_file key_file port_number"); /* Write error / ussage message.*/
+		fprintf(stderr, "Improper syntax. Try the following: Program_name plaintext_file key_file port_number [-p] [-z] [-v]"); /* Write error / ussage message.*/
 		exit(1); /* Exit. */
 	}
 
+	for (i = 4; i < argc; i++) /* Every argument after the port is a flag. */
+	{
+		if (strcmp(argv[i], "-p") == 0)
+		{
+			options |= OPTION_PACKED;
+		}
+
+		else if (strcmp(argv[i], "-z") == 0)
+		{
+			options |= OPTION_COMPRESSED;
+		}
+
+		else if (strcmp(argv[i], "-v") == 0)
+		{
+			verboseTransfer = true;
+		}
+
+		else
+		{
+			fprintf(stderr, "Unknown option %s.\n", argv[i]);
+			exit(1);
+		}
+	}
+
 	/* Call the process message function with port number, the message file, and the key file.
 	 * It is unnecessary to call the sendMessage function because the processMessage function already calls it. */
 
-	processMessage(argv[3], argv[1], argv[2]); 
+	processMessage(argv[3], argv[1], argv[2], options); 
 	return 0;
 }
 
 /****************************
-**                 void processMessage(char *port, char *messageFile, char *keyFile) 
+**                 void processMessage(char *port, char *messageFile, char *keyFile, unsigned char options) 
 ** Description: This function reads and processes the message and key files, extracting the content into key and message buffers 
 ** before attempting to connect to the server at a port via the sendMessage() function. 
 ****************************/
 
-void processMessage(char *port, char *messageFile, char *keyFile) 
+void processMessage(char *port, char *messageFile, char *keyFile, unsigned char options) 
 {
 	int error; /* Variable for holding the error. */
 
@@ -166,32 +202,34 @@ void processMessage(char *port, char *messageFile, char *keyFile)
 	 * messages and keys from the buffers before we can call the sendMessage() function. */
 
 	/* Scan the message. If any character is not either a space or between 'A' and 'Z' on the ASCII table, print a 
-	 * message declaring the message to be invalid, and exit in failure. */
+	 * message declaring the message to be invalid, and exit in failure. findInvalidCharacter() returns the offset of the first bad character,
+	 * or the length if there is none. */
+
+	size_t badOffset = findInvalidCharacter(messageBuffer, messageLength);
 
-	for (size_t i = 0; i < messageLength; i++)
+	if (badOffset != messageLength)
 	{
-		if (!(messageBuffer[i] == ' ' || (messageBuffer[i] >= 'A' && messageBuffer[i] <= 'Z'))) 
-		{
-			fprintf(stderr, "Invalid message character encountered. %c. Exiting due to error.\n", messageBuffer[i]); /* Write invalid message message while specifying exit. */
-			printf("For reference, here is the contents of the message buffer: %s", messageBuffer); /* Print the message for reference. */
-			exit(1); /* Exit in failure. */
-		}
+		fprintf(stderr, "Invalid message character encountered. %c. Exiting due to error.\n", messageBuffer[badOffset]); /* Write invalid message message while specifying exit. */
+		printf("For reference, here is the contents of the message buffer: %s", messageBuffer); /* Print the message for reference. */
+		exit(1); /* Exit in failure. */
+	}
 
-	/* We can put the key buffer validation in the same input, since by definition, the key buffer
+	/* We check the key up to the message length as well, since by definition, the key buffer
 	 * must be at least as long as the plaintext buffer (if the program has reached this far without an error induced exit). */
 
-		if (!(keyBuffer[i] == ' ' || (keyBuffer[i] >= 'A' && keyBuffer[i] <= 'Z'))) 
-		{
-			fprintf(stderr, "Invalid key character %c.\n", keyBuffer[i]); /* Print the invalid character in the key.*/
-			printf("For reference, here is the contents of the key buffer: %s", keyBuffer);
-			exit(1);
-		}
+	badOffset = findInvalidCharacter(keyBuffer, messageLength);
+
+	if (badOffset != messageLength)
+	{
+		fprintf(stderr, "Invalid key character %c.\n", keyBuffer[badOffset]); /* Print the invalid character in the key.*/
+		printf("For reference, here is the contents of the key buffer: %s", keyBuffer);
+		exit(1);
 	}
 
 	/* Now that the contents of the message and key buffers have been validated, we can call the sendMessage()
 	 * function in order to communicate with the server that will encrypt / decrypt our request. */
 
-	sendMessage(port, messageBuffer, keyBuffer, messageLength);
+	sendMessage(port, messageBuffer, keyBuffer, messageLength, options);
 
 	/* After the sendMessage() function returns, we can free the message and key buffers, as they aren't needed any more, 
 	 * and we want to prevent memory leaks. */
@@ -200,7 +238,13 @@ void processMessage(char *port, char *messageFile, char *keyFile)
 	free(keyBuffer);
 }
 
-void sendMessage(char *port, char *messageBuffer, char *keyBuffer, size_t messageLength) 
+/****************************
+**                 void sendMessage(char *port, char *messageBuffer, char *keyBuffer, size_t messageLength, unsigned char options) 
+** Description: Connects to the server, does the handshake, negotiates the options if any were asked for, sends the 
+** message and key, and writes the response to STDOUT. 
+****************************/
+
+void sendMessage(char *port, char *messageBuffer, char *keyBuffer, size_t messageLength, unsigned char options) 
 {
 	int portNumber = atoi(port); /* Convert the port char parameter from a string to an integer, then assign the value to the portNumber variable. */
 	int socketfd; /* Holds the file descriptor for the socket. */
@@ -213,6 +257,11 @@ void sendMessage(char *port, char *messageBuffer, char *keyBuffer, size_t messag
 	char client_type = SERVERTYPE; 
 	char server_type = 2;
 
+	if (options != 0) /* Asking for options is done by setting OPTIONS_FLAG on our type byte. The server answers with the flag set on its own. */
+	{
+		client_type = (char)(client_type | OPTIONS_FLAG);
+	}
+
 	/* Open the socket with error checking and handling. */
 	socketfd = socket(AF_INET, SOCK_STREAM, 0); /* With IP protocols, the last digit is 0. */
 
@@ -241,6 +290,12 @@ void sendMessage(char *port, char *messageBuffer, char *keyBuffer, size_t messag
 		exit(2);
 	}
 
+	/* Every step of the protocol is a few small writes followed by a read. With Nagle's algorithm on, the second small write waits for
+	   the server to acknowledge the first, which it delays for up to 40 ms, so even a 20 character request took over 40 ms. */
+
+	int noDelay = 1;
+	setsockopt(socketfd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
 	/* Attempt to write client type to the socket. */
 	error = write(socketfd, &client_type, sizeof(char));
 	if (error < 0) 
@@ -268,6 +323,17 @@ void sendMessage(char *port, char *messageBuffer, char *keyBuffer, size_t messag
 		exit(2);
 	}
 
+	/* Send the options we want and read back the ones the server agreed to. Anything it did not agree to falls back to the plain protocol. */
+
+	if (options != 0)
+	{
+		if (writeAll(socketfd, &options, sizeof(char)) < 0 || readAll(socketfd, &options, sizeof(char)) <= 0)
+		{
+			fprintf(stderr, "Error negotiating options with the server");
+			exit(2);
+		}
+	}
+
 	/* Attempt to write message length to socket, with error checking and handling. */
 
 	error = write(socketfd, &messageLength, sizeof(size_t));
@@ -277,8 +343,14 @@ void sendMessage(char *port, char *messageBuffer, char *keyBuffer, size_t messag
 		exit(2);
 	}
 
+	/* The message is the plaintext leg when encrypting, and the response is the plaintext leg when decrypting. Only that leg is compressed. */
+
+	unsigned char messageOptions = legOptions(options, SERVERTYPE == 'e');
+	unsigned char keyOptions = legOptions(options, false);
+	unsigned char responseOptions = legOptions(options, SERVERTYPE == 'd');
+
 	/* Attempt to send message to the server by writing the message buffer to the socket. */
-	error = write(socketfd, messageBuffer, messageLength);
+	error = sendText(socketfd, messageBuffer, messageLength, messageOptions);
 	if (error < 0) 
 	{
 		fprintf(stderr, "Error writing message to the socket");
@@ -286,7 +358,7 @@ void sendMessage(char *port, char *messageBuffer, char *keyBuffer, size_t messag
 	}
 
 	/* Attempt to send key to the server by writing the key buffer to the socket. */
-	error = write(socketfd, keyBuffer, messageLength);
+	error = sendText(socketfd, keyBuffer, messageLength, keyOptions);
 	if (error < 0) 
 	{
 		fprintf(stderr, "Error writing key to the socket");
@@ -296,13 +368,24 @@ void sendMessage(char *port, char *messageBuffer, char *keyBuffer, size_t messag
 	/* Eventually, after the server is done with everything, it will eventually provide a response. Either the plaintext or encrypted
 	 * version of the message in the buffer. The server will write it to the socket, so here we read the message buffer from the socket, then write it to STDOUT. */
 
-	error = read(socketfd, messageBuffer, messageLength); /* Attempt to read message buffer from socket with error checking. */
+	error = receiveText(socketfd, messageBuffer, messageLength, responseOptions); /* Attempt to read the whole message buffer from socket with error checking. */
 	if (error < 0) 
 	{
 		fprintf(stderr, "Error reading server response from socket");
 		exit(2);
 	}
 
+	if ((size_t)error < messageLength) /* The server closes the connection without a full response if it rejected our message or key. */
+	{
+		fprintf(stderr, "Server rejected the request.\n");
+		exit(2);
+	}
+
+	if (verboseTransfer) /* readAll() and writeAll() keep count of every payload byte, so the wire formats can be compared. */
+	{
+		fprintf(stderr, "payload bytes sent: %zu, payload bytes received: %zu\n", payloadBytesWritten, payloadBytesRead);
+	}
+
 	/* Write the newly read response message buffer to STDOUT. */
 
 	write(STDOUT_FILENO, messageBuffer, messageLength);
@@ -0,0 +1,443 @@
+/**************************
+** Filename: otp.h
+** Author: Eddie Fox
+** Date: December 3, 2016
+**
+** Description: Helpers shared by the client and the server. Since compileall builds each program from a single
+** c file, everything in here is static, and each program simply gets its own copy when it includes this header.
+** It holds the input validator, which checks that a buffer only contains capital letters and spaces, the
+** socket helpers that keep reading or writing until a whole buffer has gone through, and the packed wire format.
+**
+** Handshake options: a client that wants more than the plain protocol sends its type byte with OPTIONS_FLAG set.
+** A server that understands options answers with its own type byte with OPTIONS_FLAG set, the client then sends one
+** byte of OPTION_ bits, and the server answers with the bits it agreed to. An older server sees a type byte it does
+** not know and rejects the connection like any other mismatch.
+**
+** Packed format: there are only 27 symbols, so each one fits in 5 bits. Groups of 8 symbols are packed into 5 bytes,
+** with the first symbol in the lowest bits, and a final partial group takes as many bytes as its bits need. The
+** message length sent in the header is still the number of symbols, not the number of packed bytes.
+**
+** Compressed format: the leg that carries plaintext, which is the message when encrypting and the response when
+** decrypting, can be sent through zlib instead. It is sent as a size_t with the compressed size followed by the
+** compressed bytes. The key and the ciphertext are random and would not shrink, so they are sent raw or packed.
+** Programs that include this header need to be linked with -lz.
+*************************/
+
+#ifndef OTP_H
+#define OTP_H
+
+#include <stddef.h> /* Provides size_t. */
+#include <unistd.h> /* Provides read(), write() and ssize_t. */
+#include <errno.h> /* Provides errno and EINTR. */
+#include <stdlib.h> /* Provides malloc() and free() for the packing buffers. */
+#include <stdint.h> /* Provides uint64_t for packing groups of symbols. */
+#include <zlib.h> /* Provides compress2() and uncompress() for the compressed format. */
+
+#define OPTIONS_FLAG 0x80 /* Set on the type byte in the handshake when an options byte follows. */
+#define OPTION_PACKED 0x01 /* Message, key and response are sent 5 bits per symbol. */
+#define OPTION_COMPRESSED 0x02 /* The plaintext leg is sent through zlib. */
+
+#define SUPPORTED_OPTIONS (OPTION_PACKED | OPTION_COMPRESSED) /* Every option this build knows how to handle. */
+
+/* Running totals of the bytes that went through readAll() and writeAll(), which every transfer goes through. The client prints them with -v.
+   The server receives and sends from different threads for a large request, so each thread keeps its own totals instead of racing on one. */
+
+static __thread size_t payloadBytesRead = 0;
+static __thread size_t payloadBytesWritten = 0;
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h> /* SIMD intrinsics for the validator. SSE2 is always there on x86-64, AVX2 only if compiled with -mavx2. */
+#endif
+
+/****************************
+**                    size_t findInvalidCharacter(const char *buffer, size_t length)
+** Description: Returns the offset of the first character in the buffer that is not a space or between 'A' and 'Z'.
+** If every character is valid, it returns length. With SIMD available it checks 32 bytes per iteration: a byte is
+** valid if it equals ' ', or if it is greater than '@' and less than '[' as a signed byte. Bytes of 128 and up are
+** negative as signed bytes, so they fail the range test without any extra work. The first bad byte is then found
+** from the bit mask of valid bytes. Whatever is left over at the end goes through the plain one byte check.
+****************************/
+
+static size_t findInvalidCharacter(const char *buffer, size_t length)
+{
+	size_t i = 0; /* Offset of the next byte to check. */
+
+#if defined(__AVX2__)
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i belowA = _mm256_set1_epi8('A' - 1);
+	const __m256i aboveZ = _mm256_set1_epi8('Z' + 1);
+
+	for (; i + 32 <= length; i += 32)
+	{
+		__m256i chunk = _mm256_loadu_si256((const __m256i *)(buffer + i));
+		__m256i isSpace = _mm256_cmpeq_epi8(chunk, space);
+		__m256i isLetter = _mm256_and_si256(_mm256_cmpgt_epi8(chunk, belowA), _mm256_cmpgt_epi8(aboveZ, chunk));
+		unsigned int validMask = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(isSpace, isLetter));
+
+		if (validMask != 0xFFFFFFFFu) /* At least one byte in this chunk is invalid, and the lowest zero bit is the first one. */
+		{
+			return i + __builtin_ctz(~validMask);
+		}
+	}
+#elif defined(__SSE2__)
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i belowA = _mm_set1_epi8('A' - 1);
+	const __m128i aboveZ = _mm_set1_epi8('Z' + 1);
+
+	for (; i + 32 <= length; i += 32) /* Two 16 byte halves per iteration, so the loop covers 32 bytes like the AVX2 one. */
+	{
+		__m128i low = _mm_loadu_si128((const __m128i *)(buffer + i));
+		__m128i high = _mm_loadu_si128((const __m128i *)(buffer + i + 16));
+		__m128i lowValid = _mm_or_si128(_mm_cmpeq_epi8(low, space), _mm_and_si128(_mm_cmpgt_epi8(low, belowA), _mm_cmplt_epi8(low, aboveZ)));
+		__m128i highValid = _mm_or_si128(_mm_cmpeq_epi8(high, space), _mm_and_si128(_mm_cmpgt_epi8(high, belowA), _mm_cmplt_epi8(high, aboveZ)));
+		unsigned int validMask = (unsigned int)_mm_movemask_epi8(lowValid) | ((unsigned int)_mm_movemask_epi8(highValid) << 16);
+
+		if (validMask != 0xFFFFFFFFu)
+		{
+			return i + __builtin_ctz(~validMask);
+		}
+	}
+#endif
+
+	for (; i < length; i++) /* Leftover bytes, or the whole buffer if there is no SIMD. */
+	{
+		if (!(buffer[i] == ' ' || (buffer[i] >= 'A' && buffer[i] <= 'Z')))
+		{
+			return i;
+		}
+	}
+
+	return length;
+}
+
+/****************************
+**                    ssize_t readAll(int fd, void *buffer, size_t length)
+** Description: A single read() on a socket can return less than was asked for, especially for big messages
+** like plaintext4. This keeps reading until length bytes have arrived. Returns the number of bytes read, which is
+** only less than length if the other side closed the connection, or -1 on an error.
+****************************/
+
+static ssize_t readAll(int fd, void *buffer, size_t length)
+{
+	size_t total = 0; /* How many bytes have arrived so far. */
+
+	while (total < length)
+	{
+		ssize_t count = read(fd, (char *)buffer + total, length - total);
+
+		if (count < 0 && errno == EINTR) /* Interrupted by a signal like SIGCHLD before anything arrived, so just try again. */
+		{
+			continue;
+		}
+
+		if (count < 0)
+		{
+			return -1;
+		}
+
+		if (count == 0) /* The other side closed the connection. */
+		{
+			break;
+		}
+
+		total += count;
+		payloadBytesRead += count;
+	}
+
+	return total;
+}
+
+/****************************
+**                    ssize_t writeAll(int fd, const void *buffer, size_t length)
+** Description: The writing counterpart of readAll(). Keeps writing until the whole buffer has been sent. Returns
+** length, or -1 on an error.
+****************************/
+
+static ssize_t writeAll(int fd, const void *buffer, size_t length)
+{
+	size_t total = 0; /* How many bytes have been sent so far. */
+
+	while (total < length)
+	{
+		ssize_t count = write(fd, (const char *)buffer + total, length - total);
+
+		if (count < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (count < 0)
+		{
+			return -1;
+		}
+
+		total += count;
+		payloadBytesWritten += count;
+	}
+
+	return total;
+}
+
+/****************************
+**                    size_t packedLength(size_t length)
+** Description: Returns how many bytes length symbols take up in the packed format. Whole groups are counted first,
+** so that length * 5 is never formed and cannot overflow, whatever length is.
+****************************/
+
+static size_t packedLength(size_t length)
+{
+	return length / 8 * 5 + (length % 8 * 5 + 7) / 8;
+}
+
+/****************************
+**                    void packSymbols(const char *text, size_t length, unsigned char *packed)
+** Description: Packs length characters of text, which must already be validated, into packedLength(length) bytes.
+** Space becomes 26 and 'A' through 'Z' become 0 through 25, the same numbering OTP() uses.
+****************************/
+
+static void packSymbols(const char *text, size_t length, unsigned char *packed)
+{
+	size_t i = 0; /* Index of the next symbol to pack. */
+
+	while (i < length)
+	{
+		uint64_t bits = 0; /* Up to 8 symbols, 40 bits, collected before they are written out. */
+		size_t count = (length - i < 8) ? length - i : 8; /* Symbols in this group, 8 except maybe for the last one. */
+		size_t j;
+
+		for (j = 0; j < count; j++)
+		{
+			uint64_t symbol = (text[i + j] == ' ') ? 26 : (uint64_t)(text[i + j] - 'A');
+			bits |= symbol << (5 * j);
+		}
+
+		for (j = 0; j < (count * 5 + 7) / 8; j++) /* Write out only the bytes this group needs, lowest byte first. */
+		{
+			*packed++ = (unsigned char)(bits >> (8 * j));
+		}
+
+		i += count;
+	}
+}
+
+/****************************
+**                    void unpackSymbols(const unsigned char *packed, size_t length, char *text)
+** Description: Reverses packSymbols(), writing length characters to text. The values 27 to 31 cannot come from a
+** valid packing, and they unpack to characters after 'Z' so the validator will catch them.
+****************************/
+
+static void unpackSymbols(const unsigned char *packed, size_t length, char *text)
+{
+	size_t i = 0; /* Index of the next symbol to unpack. */
+
+	while (i < length)
+	{
+		uint64_t bits = 0;
+		size_t count = (length - i < 8) ? length - i : 8;
+		size_t j;
+
+		for (j = 0; j < (count * 5 + 7) / 8; j++)
+		{
+			bits |= (uint64_t)(*packed++) << (8 * j);
+		}
+
+		for (j = 0; j < count; j++)
+		{
+			int symbol = (int)((bits >> (5 * j)) & 31);
+			text[i + j] = (symbol == 26) ? ' ' : (char)('A' + symbol);
+		}
+
+		i += count;
+	}
+}
+
+/****************************
+**                    ssize_t readPacked(int fd, char *text, size_t length)
+** Description: Reads length packed symbols from the socket and unpacks them into text. Returns length if every byte
+** arrived, a smaller number if the connection closed early, or -1 on an error, just like readAll().
+****************************/
+
+static ssize_t readPacked(int fd, char *text, size_t length)
+{
+	unsigned char *packed = malloc(packedLength(length) + 1); /* +1 so that a zero length message still gets a real allocation. */
+	ssize_t count;
+
+	if (packed == NULL)
+	{
+		return -1;
+	}
+
+	count = readAll(fd, packed, packedLength(length));
+
+	if (count >= 0 && (size_t)count == packedLength(length))
+	{
+		unpackSymbols(packed, length, text);
+		count = length;
+	}
+
+	else if (count >= 0)
+	{
+		count = 0; /* Short read. A partial packed buffer is useless, so report it as nothing received. */
+	}
+
+	free(packed);
+	return count;
+}
+
+/****************************
+**                    ssize_t writePacked(int fd, const char *text, size_t length)
+** Description: Packs length characters of text and writes them to the socket. Returns length, or -1 on an error.
+****************************/
+
+static ssize_t writePacked(int fd, const char *text, size_t length)
+{
+	unsigned char *packed = malloc(packedLength(length) + 1);
+	ssize_t count;
+
+	if (packed == NULL)
+	{
+		return -1;
+	}
+
+	packSymbols(text, length, packed);
+	count = writeAll(fd, packed, packedLength(length));
+	free(packed);
+
+	return (count < 0) ? -1 : (ssize_t)length;
+}
+
+/****************************
+**                    ssize_t readCompressed(int fd, char *text, size_t length)
+** Description: Reads a compressed leg from the socket and inflates it into the length characters of text. Returns 
+** length on success, 0 if the connection closed early or the data did not inflate to exactly length characters, or
+** -1 on an error.
+****************************/
+
+static ssize_t readCompressed(int fd, char *text, size_t length)
+{
+	size_t compressedLength; /* Size of the compressed data that follows. */
+	uLongf inflatedLength = length; /* uncompress() sets this to how much it actually wrote. */
+	unsigned char *compressed;
+	ssize_t count;
+
+	count = readAll(fd, &compressedLength, sizeof(size_t));
+
+	if (count <= 0 || (size_t)count < sizeof(size_t))
+	{
+		return count;
+	}
+
+	if (compressedLength > compressBound(length)) /* No honest sender needs more than this, so do not let it make us allocate more. */
+	{
+		return 0;
+	}
+
+	compressed = malloc(compressedLength + 1);
+
+	if (compressed == NULL)
+	{
+		return -1;
+	}
+
+	count = readAll(fd, compressed, compressedLength);
+
+	if (count >= 0 && (size_t)count == compressedLength)
+	{
+		int result = uncompress((Bytef *)text, &inflatedLength, compressed, compressedLength);
+		count = (result == Z_OK && inflatedLength == length) ? (ssize_t)length : 0;
+	}
+
+	else if (count >= 0)
+	{
+		count = 0;
+	}
+
+	free(compressed);
+	return count;
+}
+
+/****************************
+**                    ssize_t writeCompressed(int fd, const char *text, size_t length)
+** Description: Compresses length characters of text with zlib and writes the size and the compressed data to the 
+** socket. Level 1 is used, since on these links the time to compress matters as much as the bytes saved. Returns 
+** length, or -1 on an error.
+****************************/
+
+static ssize_t writeCompressed(int fd, const char *text, size_t length)
+{
+	uLongf compressedSize = compressBound(length);
+	unsigned char *compressed = malloc(compressedSize);
+	size_t compressedLength;
+	ssize_t count = -1;
+
+	if (compressed == NULL)
+	{
+		return -1;
+	}
+
+	if (compress2(compressed, &compressedSize, (const Bytef *)text, length, 1) == Z_OK)
+	{
+		compressedLength = compressedSize;
+
+		if (writeAll(fd, &compressedLength, sizeof(size_t)) >= 0 && writeAll(fd, compressed, compressedLength) >= 0)
+		{
+			count = length;
+		}
+	}
+
+	free(compressed);
+	return count;
+}
+
+/****************************
+**                    ssize_t receiveText(int fd, char *text, size_t length, unsigned char options)
+** Description: Reads length characters from the socket in whichever format options says. OPTION_COMPRESSED wins
+** over OPTION_PACKED, so callers clear it for legs that are not plaintext.
+****************************/
+
+static ssize_t receiveText(int fd, char *text, size_t length, unsigned char options)
+{
+	if (options & OPTION_COMPRESSED)
+	{
+		return readCompressed(fd, text, length);
+	}
+
+	if (options & OPTION_PACKED)
+	{
+		return readPacked(fd, text, length);
+	}
+
+	return readAll(fd, text, length);
+}
+
+/****************************
+**                    ssize_t sendText(int fd, const char *text, size_t length, unsigned char options)
+** Description: Writes length characters to the socket in whichever format options says, like receiveText().
+****************************/
+
+static ssize_t sendText(int fd, const char *text, size_t length, unsigned char options)
+{
+	if (options & OPTION_COMPRESSED)
+	{
+		return writeCompressed(fd, text, length);
+	}
+
+	if (options & OPTION_PACKED)
+	{
+		return writePacked(fd, text, length);
+	}
+
+	return writeAll(fd, text, length);
+}
+
+/****************************
+**                    unsigned char legOptions(unsigned char options, int plaintext)
+** Description: Returns the options that apply to one leg of the transfer. Only the plaintext leg is compressed. 
+****************************/
+
+static unsigned char legOptions(unsigned char options, int plaintext)
+{
+	return plaintext ? options : (unsigned char)(options & ~OPTION_COMPRESSED);
+}
+
+#endif
@@ -10,9 +10,28 @@
 ** via the same communication socket. If the DECRYPT macro is defined, it will decrypt cipher text provided by the client. 
 ** The server provides support for 5 concurrent connections, and  creates error messages when it should, like if the key isn't
 ** at least as big as the plaintext, if the client or server is configured in the wrong type, or if there failed to be a connection 
-** through the socket. 
+** through the socket. If compiled with neither macro, the same program serves encrypt and decrypt clients on one port, choosing
+** the operation from the handshake.
+**
+** Sending the running server SIGUSR2 restarts it without refusing any connections. The server re-executes its own binary
+** (so an upgraded otp_enc_d on disk gets picked up), handing the new process the already listening socket through the
+** OTP_LISTEN_FD environment variable. Once the new server is running, the old one stops accepting, lets its in-flight
+** children finish, and then exits.
+**
+** Usage: otp_enc_d port [-s size] [-t threads] [-l size]. A request of at least size characters (4 MB unless -s says
+** otherwise, -s 0 turns it off) is split into slices that a pool of threads works on, so that one huge job can use every
+** core. The slices are worked on as soon as their part of the key has arrived, and sent back in order as soon as they are
+** done, so receiving, computing and sending all overlap. -t sets how many threads, by default one per core.
+**
+** Requests are scheduled by size, so that a burst of huge jobs does not hold up the small ones behind it. Every request up
+** to the -l size (4 KB by default, -l 0 turns it off) is in the fast lane and runs at normal priority. Every bigger one is
+** in the bulk lane, and its child lowers its own priority by one nice level each time the message length doubles past that
+** size. The kernel then time-slices the bulk children, receiving and sending included, in favor of the shortest jobs, and
+** still gives them every cycle the small jobs leave over, so bulk throughput is kept.
 *************************/
 
+#define _GNU_SOURCE /* Exposes setenv(), unsetenv() and sigaction() even though we compile with -std=c99. */
+
 #include <stdio.h> /* Needed for things like printf, fgets, sprintf and perror. */
 #include <stdlib.h> /* Needed for things such as malloc, execvp, and exit. */
 #include <string.h> /* For various string operations such as strcmp and strtok. */
@@ -23,59 +42,189 @@
 #include <sys/wait.h> /* Used for waitpid(). */
 
 #include <netinet/in.h> /* Included for IP address macro manipulation.*/
+#include <netinet/tcp.h> /* Provides TCP_NODELAY. */
 #include <arpa/inet.h> /* Included for IP address macro manipulation. */
 
 #include <errno.h> /* Provides information on system error numbers. */
 #include <signal.h> /* Needed for almost everything to do with sigaction, including the structure, and various signal set related options. */
 #include <stdbool.h> /* Includes a macro that expands true to 1 and false to 0. Just for self-documentation purposes primarily.  */
+#include <fcntl.h> /* Used for fcntl() and the close-on-exec flag during a restart. */
+#include <poll.h> /* Used for ppoll(), which waits for connections with SIGUSR2 unblocked. */
+#include <pthread.h> /* Used for the threads that split a large request between them. */
+#include <sys/resource.h> /* Used for setpriority(), which puts large requests in the bulk lane. */
+
+#include "otp.h" /* Input validation and whole-buffer socket reads and writes, shared with the client. */
 
 
 /* The behavior of the server program differs based on if it is encrypting or decrypting. In the abscence of polymorphic object oriented behavior,
-   we can simulate this by how it is defined. Defining it as ENCRYPT or DECRYPT affects two key things. First, it changes the server type to either 
-   'e' for encrypt or 'd' for decrypt. The second thing it does is change the CRYPT function. The first parameter represents the message, while the second
-   one is the key. In OTP, if we are encrypting, we add the two values together, while if decrypting, we subtract them from each other. The functions are defined
-   to reflect this. */
+   we can simulate this by how it is defined. Defining it as ENCRYPT or DECRYPT changes the server type to either 'e' for encrypt or 'd' for decrypt.
+   If neither is defined, the server type is 'b' for both, and the server picks the operation for each connection from the type byte the client
+   sends in the handshake. That way one daemon on one port can stand in for both otp_enc_d and otp_dec_d. 
+
+   The CRYPT function does the actual math. The first parameter represents the message, the second one is the key, and the third one is the operation
+   of the connection, 'e' or 'd'. In OTP, if we are encrypting, we add the two values together, while if decrypting, we subtract them from each other. */
 
 /* I don't actually know if I can comment on preprocessor define macros, but I'm paranoid that if I do, they will be added every time, so I'm going to not to be safe.
 Another note is that I am casting each of the parameters to an int, as they are originally passed in as char pointer buffers, and we need to perform math on them. */
 
 #ifdef ENCRYPT
-
 #define SERVERTYPE 'e'
-#define CRYPT(a, b) (a) = (int)( (int)(a) + (int)(b) );
-
 #elif DECRYPT
 #define SERVERTYPE 'd'
-#define CRYPT(a, b) (a) = (int)( (int)(a) - (int)(b) );
+#else
+#define SERVERTYPE 'b'
+#endif
+
+/* A large request is split into slices of PARALLEL_SLICE characters. A slice of the message and the same slice of the key together
+   take 256 KB, which stays in the L2 cache of a core while it is being worked on. It is a multiple of 8, so that a slice of a packed
+   leg is a whole number of bytes. */
+
+#define DEFAULT_SPLIT_SIZE (4 * 1024 * 1024)
+#define PARALLEL_SLICE (128 * 1024)
+#define MAX_COMPUTE_THREADS 256 /* The most -t allows, well past the cores of any machine this runs on. */
 
-#endif 
+/* Requests of up to SMALL_JOB_SIZE characters are in the fast lane. LISTEN_BACKLOG is how many connections can wait to be accepted.
+   It used to be 5, which made a burst of small jobs wait a whole second for the client to retry its connection. */
+
+#define SMALL_JOB_SIZE 4096
+#define LISTEN_BACKLOG 128
+
+/* The message length comes from the client, so it is not trusted to size the buffers. The message and the key each take this much,
+   and a longer message is rejected before anything is allocated. */
+
+#define MAX_MESSAGE_LENGTH ((size_t)1 << 30)
+
+#define CRYPT(a, b, mode) (a) = (int)( (mode) == 'e' ? (int)(a) + (int)(b) : (int)(a) - (int)(b) );
 
 /* Here we forward declare the function prototypes, so if the functions reference each other, they won't be confused
    as to the meaning of other functions that have yet to be declared.*/
 
 void exitServer(int a);
 void endingChild(int signalNumber);
+void requestRestart(int signalNumber);
 
-void OTP(size_t messageLength, char *keyBuffer, char*messageBuffer);
+void OTP(size_t messageLength, char *keyBuffer, char *messageBuffer, char mode);
+char serverTypeFor(char clientType);
 
 void setup(int portNumber);
 
 void serverLoop(int socketfd);
+void serveClient(int clientsocketfd);
 void cleanup(int clientsocketfd, char *keyBuffer, char *messageBuffer);
+void scheduleBySize(size_t messageLength);
+
+void serveInParallel(int clientsocketfd, char *messageBuffer, char *keyBuffer, size_t messageLength, char mode, unsigned char options);
+void *computeSlices(void *argument);
+void *sendSlices(void *argument);
+
+bool restartServer(int socketfd);
+
+/* restartRequested is set by the SIGUSR2 handler and checked by the serverLoop, since almost nothing is safe to do inside of a handler.
+   serverArguments keeps a copy of argv so that the server can exec itself again with the same port when restarting. */
+
+volatile sig_atomic_t restartRequested = 0;
+char **serverArguments;
+
+/* splitSize and computeThreads come from -s and -t. A request of at least splitSize characters is served by computeThreads threads. 
+   smallJobSize comes from -l, and is the biggest request in the fast lane. */
+
+size_t splitSize = DEFAULT_SPLIT_SIZE;
+long computeThreads;
+size_t smallJobSize = SMALL_JOB_SIZE;
+
+/* A parallelJob is everything the threads serving one large request share. The connection's own thread receives the key into
+   keyBuffer and moves received forward, the compute threads take the slices in order once their part of the key is there, and the
+   sending thread sends the finished slices in order. Everything after the buffers is protected by lock, and changed is signalled
+   whenever received, sliceDone or failed changes. */
+
+struct parallelJob
+{
+	int clientsocketfd;
+	char *messageBuffer, *keyBuffer;
+	size_t messageLength;
+	char mode; /* 'e' or 'd', like OTP(). */
+	unsigned char responseOptions; /* The options of the response leg. */
+
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	size_t received; /* Characters of the key that have arrived. */
+	size_t nextSlice; /* The next slice for a compute thread to take. */
+	size_t numberOfSlices;
+	bool *sliceDone; /* Which slices have been worked on and can be sent. */
+	bool failed; /* Set by any thread that runs into a problem, which stops all the others. */
+};
 
 int main(int argc, char *argv[]) 
 {
 	int portNumber; /* Variable to hold the port number. */
 
-	if (argc != 2) /* The server only takes the name of the program and the number of the port to listen on. If there isn't 2 arguments, the syntax is wrong, and it exits as a failure.*/
+	int i; /* Loop control variable. */
+
+	if (argc < 2 || argc % 2 != 0) /* The server takes the name of the program, the number of the port to listen on, and flags that each take a number. Anything else is wrong, and it exits as a failure.*/
 	{
-		fprintf(stderr, "Improper syntax.\n"); /* Notify user of improper syntax.*/
+		fprintf(stderr, "Improper syntax. Try the following: Program_name port_number [-s size] [-t threads] [-l size]\n"); /* Notify user of improper syntax.*/
 		exit(1); /* Exit as a failure.*/
 	}
 
+	computeThreads = sysconf(_SC_NPROCESSORS_ONLN); /* One thread per core unless -t says otherwise. */
+
+	if (computeThreads > MAX_COMPUTE_THREADS)
+	{
+		computeThreads = MAX_COMPUTE_THREADS;
+	}
+
+	for (i = 2; i < argc; i += 2) /* Every argument after the port is a flag followed by its number. */
+	{
+		char *end;
+		long long value = strtoll(argv[i + 1], &end, 10);
+
+		if (*argv[i + 1] == '\0' || *end != '\0' || value < 0 || (strcmp(argv[i], "-s") != 0 && strcmp(argv[i], "-t") != 0 && strcmp(argv[i], "-l") != 0))
+		{
+			fprintf(stderr, "Unknown option %s %s.\n", argv[i], argv[i + 1]);
+			exit(1);
+		}
+
+		if (strcmp(argv[i], "-s") == 0)
+		{
+			splitSize = (size_t)value;
+		}
+
+		else if (strcmp(argv[i], "-l") == 0)
+		{
+			smallJobSize = (size_t)value;
+		}
+
+		else if (value > MAX_COMPUTE_THREADS)
+		{
+			fprintf(stderr, "At most %d threads can be given with -t.\n", MAX_COMPUTE_THREADS);
+			exit(1);
+		}
+
+		else
+		{
+			computeThreads = (long)value;
+		}
+	}
+
 	signal(SIGINT, exitServer); /* Signal handler for interrupts that calls the exitServer function. */
 	signal(SIGCHLD, endingChild); /* Signal handle for child signals that calls the endingChild function.*/
 
+	/* SIGUSR2 is kept blocked everywhere except while the server loop waits for a connection in ppoll(), which unblocks it and
+	   returns with EINTR when it comes in. A signal that arrives between checking restartRequested and waiting stays pending until
+	   the wait starts, so the restart is noticed right away even on an idle server, instead of after the next connection. */
+
+	struct sigaction restartAction;
+	sigset_t restartSignal;
+	memset(&restartAction, 0, sizeof(restartAction));
+	restartAction.sa_handler = requestRestart;
+	sigemptyset(&restartAction.sa_mask);
+	sigaction(SIGUSR2, &restartAction, NULL);
+	sigemptyset(&restartSignal);
+	sigaddset(&restartSignal, SIGUSR2);
+	sigprocmask(SIG_BLOCK, &restartSignal, NULL);
+
+	serverArguments = argv; /* Remember the arguments for restarts. */
+
 	portNumber = atoi(argv[1]); /* Processes the first argument, and converts it from string to integer, then assigns the integer to the port number variable. */
 	setup(portNumber); /* Runs the setup function, which takes care of the setup, then runs serverLoop at the end. */
 }
@@ -124,6 +273,18 @@ void endingChild(int signalNumber) {
 	}
 }
 
+/****************************
+**                               void requestRestart(int signalNumber)
+** Description: This function is called if SIGUSR2 is recieved. It only raises the restartRequested flag, and 
+** the serverLoop does the actual work of restarting.
+****************************/
+
+void requestRestart(int signalNumber)
+{
+	(void)signalNumber; /* The handler is only for SIGUSR2. */
+	restartRequested = 1;
+}
+
 /****************************
 **                              void setup(int portNumber)
 ** Description: Does all the network setup with binding and listening to sockets and ports.
@@ -136,6 +297,19 @@ void setup(int portNumber) {
 
 	struct sockaddr_in serverAddress; /* Server address structure. */
 
+	/* If we were started by a restarting server, the listening socket already exists and was inherited from the old process.
+	   Binding the port again would fail because the old server still holds it, so we just adopt the socket and start serving. */
+
+	char *inheritedSocket = getenv("OTP_LISTEN_FD");
+
+	if (inheritedSocket != NULL)
+	{
+		socketfd = atoi(inheritedSocket);
+		unsetenv("OTP_LISTEN_FD"); /* Children and later restarts should not see a stale value. */
+		serverLoop(socketfd);
+		return;
+	}
+
 	/* Open socket using TCP and IP protocols. */
 
 	socketfd = socket(AF_INET, SOCK_STREAM, 0); /* When using IP protocol, you use a zero as the last parameter.*/
@@ -158,7 +332,7 @@ void setup(int portNumber) {
 		exit(2);
 	}
 
-	error = listen(socketfd, 5); /* Specifies the max number of concurrent ports to be 5. */
+	error = listen(socketfd, LISTEN_BACKLOG); /* Every connection gets its own child, so this only limits how many can wait to be accepted. */
 
 	if (error < 0) /* If there was an error, write an error message and exit in failure. */
 	{
@@ -179,120 +353,332 @@ void setup(int portNumber) {
 void serverLoop(int socketfd) 
 {
 	int newsocketfd; /* Holds the file descriptor of the new socket. */
-	int error; /* Holds errors. */
 	struct sockaddr_in clientAddress; /* Creates structure for client address.*/
 	socklen_t clilent = sizeof(clientAddress); /* Holds the size of the address for formal structure purposes. */
-	char client_type = 1; /* Sets client type. */
-	char server_type = SERVERTYPE; /* Server type is set to encrypt or decrypt accordingly based on macro definition at time of compilation. */
-	char *messageBuffer, *keyBuffer; /* Creates character array buffers to hold both the plaintext and the key. */
-	size_t messageLength; /* Creates a variable to hold the length of the message. */
+	struct pollfd listener = { socketfd, POLLIN, 0 }; /* What ppoll() waits on. */
+	sigset_t waitMask; /* The signal mask while waiting, which is the usual one with SIGUSR2 unblocked. */
+
+	sigprocmask(SIG_SETMASK, NULL, &waitMask);
+	sigdelset(&waitMask, SIGUSR2);
+
+	/* The listening socket does not block, so a connection that goes away between ppoll() and accept() cannot leave us stuck in 
+	   accept() with SIGUSR2 blocked. */
+
+	fcntl(socketfd, F_SETFL, fcntl(socketfd, F_GETFL) | O_NONBLOCK);
 
 	while (true) /* True works because of stdbool.h, which extends the true macro to 1. */
 	{
-		
+		if (restartRequested) /* Hand the listening socket to a fresh copy of the server before accepting anything else. */
+		{
+			restartRequested = 0;
+			restartServer(socketfd); /* Only returns if the new server could not be started, in which case we keep serving. */
+		}
+
+		if (ppoll(&listener, 1, NULL, &waitMask) < 0) /* Wait for a connection, or for SIGUSR2. */
+		{
+			if (errno != EINTR) /* Being interrupted by a signal is not a failure, it is how restart requests wake us up. */
+			{
+				fprintf(stderr, "Failed to wait for connections.\n");
+			}
+			continue;
+		}
+
 		newsocketfd = accept(socketfd, (struct sockaddr *) &clientAddress, &clilent); /* Accepts new connections from clients.*/
 
 		if (newsocketfd < 0) /* If the accept function failed, and no new clients were accepted, print a message saying as much. */
 		{
-			fprintf(stderr, "Failed to accept connection.\n");
+			if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) /* Being interrupted, or the connection being gone already, is not a failure. */
+			{
+				fprintf(stderr, "Failed to accept connection.\n");
+			}
+			continue; /* There is no client to fork for, so go back to accepting. */
 		}
 
 		pid_t pid = fork(); /* Fork the parent server process accordingly as connections are made. */
 
-		if (pid == 0) /* If pid is 0, then it is a child, and we check for errors and proceed with the encryption process. */
+		if (pid == 0) /* If pid is 0, then it is a child, and it takes care of this one client from start to finish. */
 		{  
-			error = read(newsocketfd, &client_type, sizeof(char)); /* Reads from the socket a single character that gives us the client type, while checking for errors.*/
-			if (error < 0) /* If there is an error, the server failed to read from the socket, so write a message indicating so, and exit. */
-			{
-				fprintf(stderr, "Failed to read client type to the socket.\n");
-				cleanup(newsocketfd, NULL, NULL); /* Call cleanup function to close the socket, clear filedescriptors, and free memory. */
-				exit(1);
-			}
+			close(socketfd); /* The child only talks to its client, so it has no use for the listening socket. */
+			serveClient(newsocketfd);
+			exit(EXIT_SUCCESS); /* Exit successfully, with an exit code of 0 unlike all these other exit codes. */
+		}
 
-			error = write(newsocketfd, &server_type, sizeof(char)); /* Attempt to write server type to the socket while checking for errors. */
-			if (error < 0) 
-			{
-				fprintf(stderr, "Failed to write program type to socket.\n"); /* If there is an error, the server failed to write its type to the socket, so write a message indicating so, and exit. */
-				cleanup(newsocketfd, NULL, NULL); /* Call cleanup function to close the socket, clear filedescriptors, and free memory. */
-				exit(1);
-			}
+		/* If it isn't a child, we continue to the next iteration of the serverLoop, accepting another connection from clients. The parent leaves
+		   the connection to the child, and closes its own copy so that the connection is fully closed once the child is done with it. */
 
-			/* At this point, we compare the server type to the client type. They will only match if an encrypt client is connecting to an encrypt server or a 
-			   decrypt client is connecting to a decrypt server. I f not, reject the connection. */
+		close(newsocketfd);
+	}
+}
 
-			if (client_type != server_type) 
-			{
-				fprintf(stderr, "Rejecting connection. Wrong type of client.\n"); /* print error message.*/
-				shutdown(newsocketfd, 2); /* Shutdown and close socket. */
-				close(newsocketfd);
-				exit(2);
-			}
+/****************************
+**                           void serveClient(int clientsocketfd)
+** Description: Runs in the child forked for each connection. Does the handshake, negotiates any options, reads the 
+** message and key, and writes back the result of OTP(). Exits directly on any error. 
+****************************/
 
-			error = read(newsocketfd, &messageLength, sizeof(size_t)); /* Read the length of the message while checking for errors. */
-			if (error < 0) 
-			{
-				fprintf(stderr, "Failed to read message length from the socket."); /* If there is an error, the server failed to read the message length from the socket. */
-				cleanup(newsocketfd, NULL, NULL); /* Clear file descriptors, close socket, and free any memory. */
-				exit(2);
-			}
+void serveClient(int clientsocketfd)
+{
+	int error; /* Holds errors. */
+	char client_type = 1; /* Sets client type. */
+	char server_type; /* Server type answered to the client, worked out from SERVERTYPE and the client type once the client has introduced itself. */
+	bool wantsOptions; /* True if the client asked to negotiate options. */
+	unsigned char options = 0; /* The OPTION_ bits agreed on with the client, none unless it asks. */
+	char *messageBuffer, *keyBuffer; /* Creates character array buffers to hold both the plaintext and the key. */
+	size_t messageLength; /* Creates a variable to hold the length of the message. */
+	int noDelay = 1; /* Turns Nagle's algorithm off, see below. */
+
+	/* The answers are small writes, like the compressed size before the compressed data. With Nagle's algorithm on, a small write that
+	   follows another one waits up to 40 ms for the client to acknowledge the first, which is most of the time a small request takes. */
+
+	setsockopt(clientsocketfd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
 
-			/* We declared the message buffer and key buffer above, but now we dynamically allocate space for them, up to the size of the message length. */
+	error = read(clientsocketfd, &client_type, sizeof(char)); /* Reads from the socket a single character that gives us the client type, while checking for errors.*/
+	if (error < 0) /* If there is an error, the server failed to read from the socket, so write a message indicating so, and exit. */
+	{
+		fprintf(stderr, "Failed to read client type to the socket.\n");
+		cleanup(clientsocketfd, NULL, NULL); /* Call cleanup function to close the socket, clear filedescriptors, and free memory. */
+		exit(1);
+	}
 
-			messageBuffer = malloc(messageLength);
-			keyBuffer = malloc(messageLength);
+	/* A client that wants options sets OPTIONS_FLAG on its type byte. We answer with the flag set on ours as well, so that it knows an options byte is expected. */
 
-			error = read(newsocketfd, messageBuffer, messageLength); /* Read the message while checking for errors.*/
+	wantsOptions = (client_type & OPTIONS_FLAG) != 0;
+	client_type = client_type & ~OPTIONS_FLAG;
 
-			if (error < 0) /* If there is an error, the server failed to read the message from the socket. */
-			{
-				fprintf(stderr, "Failed to read the message from the socket. Unknown error.\n");
-				cleanup(newsocketfd, keyBuffer, messageBuffer); /* Clear file descriptors, close socket, and free any memory. */
-				exit(2);
-			}
+	server_type = serverTypeFor(client_type); /* A multi-mode server answers with the client's own type if it is one we can serve. */
+	char answer_type = wantsOptions ? (char)(server_type | OPTIONS_FLAG) : server_type;
+
+	error = write(clientsocketfd, &answer_type, sizeof(char)); /* Attempt to write server type to the socket while checking for errors. */
+	if (error < 0) 
+	{
+		fprintf(stderr, "Failed to write program type to socket.\n"); /* If there is an error, the server failed to write its type to the socket, so write a message indicating so, and exit. */
+		cleanup(clientsocketfd, NULL, NULL); /* Call cleanup function to close the socket, clear filedescriptors, and free memory. */
+		exit(1);
+	}
 
-			error = read(newsocketfd, keyBuffer, messageLength); /* Read the key while checking for errors. */
+	/* At this point, we compare the server type to the client type. They will only match if an encrypt client is connecting to an encrypt server or a 
+	   decrypt client is connecting to a decrypt server. I f not, reject the connection. */
 
-			if (error < 0) /* If there is an error, the server failed to read the key from the socket.*/
-			{
-				fprintf(stderr, "Failed to read from socket");
-				cleanup(newsocketfd, keyBuffer, messageBuffer); /* Clear file descriptors, close socket, and free any memory. */
-				exit(2);
-			}
-			
-			/* Now we call the actual OTP (One Time Pad) function do the actual encryption / decryption, and write the result back to the message buffer. */
+	if (client_type != server_type) 
+	{
+		fprintf(stderr, "Rejecting connection. Wrong type of client.\n"); /* print error message.*/
+		shutdown(clientsocketfd, 2); /* Shutdown and close socket. */
+		close(clientsocketfd);
+		exit(2);
+	}
 
-			OTP(messageLength, keyBuffer, messageBuffer);
+	/* Options are negotiated right after the types match. We agree to every option we support, and answer with the ones we agreed to. */
 
-			error = write(newsocketfd, messageBuffer, messageLength); /* After storing the result in the messageBuffer, we write the response back to the client while error checking.*/
-			
-			if (error < 0) /* If there was an error, the server somehow failed to write back to the socket.*/
-			{
-				fprintf(stderr, "Failed writing to socket."); 
-			}
-			
-			/* If the program has reached this point, it has done it's job, so we call clean up to clear file descriptors, close the socket, and free memory. 
-			   The porgram can then exit successfully. */
+	if (wantsOptions)
+	{
+		error = readAll(clientsocketfd, &options, sizeof(char));
+		options &= SUPPORTED_OPTIONS;
 
-			cleanup(newsocketfd, keyBuffer, messageBuffer); /* Call cleanup.*/
-			exit(EXIT_SUCCESS); /* Exit successfully, with an exit code of 0 unlike all these other exit codes. */
+		if (error <= 0 || writeAll(clientsocketfd, &options, sizeof(char)) < 0)
+		{
+			fprintf(stderr, "Failed to negotiate options with the client.\n");
+			cleanup(clientsocketfd, NULL, NULL);
+			exit(2);
 		}
+	}
 
-		/* If it isn't a child, we continue to the next iteration of the serverLoop, accepting another connection from clients. */
-		
-		else 
+	error = readAll(clientsocketfd, &messageLength, sizeof(size_t)); /* Read the length of the message while checking for errors. */
+	if (error < 0 || (size_t)error < sizeof(size_t)) /* An error, or the client closed the connection before the whole length arrived. */
+	{
+		fprintf(stderr, "Failed to read message length from the socket."); /* If there is an error, the server failed to read the message length from the socket. */
+		cleanup(clientsocketfd, NULL, NULL); /* Clear file descriptors, close socket, and free any memory. */
+		exit(2);
+	}
+
+	if (messageLength > MAX_MESSAGE_LENGTH)
+	{
+		fprintf(stderr, "Rejecting connection. Message length %zu is over the limit of %zu.\n", messageLength, MAX_MESSAGE_LENGTH);
+		cleanup(clientsocketfd, NULL, NULL);
+		exit(2);
+	}
+
+	scheduleBySize(messageLength); /* Pick the lane before anything else, so that receiving a large message is already in the bulk lane. */
+
+	/* We declared the message buffer and key buffer above, but now we dynamically allocate space for them, up to the size of the message length. */
+
+	messageBuffer = malloc(messageLength + 1); /* +1 so that an empty message still gets a real allocation. */
+	keyBuffer = malloc(messageLength + 1);
+
+	if (messageBuffer == NULL || keyBuffer == NULL)
+	{
+		fprintf(stderr, "Failed to allocate %zu bytes for the message and the key.\n", messageLength);
+		cleanup(clientsocketfd, keyBuffer, messageBuffer);
+		exit(2);
+	}
+
+	/* The message is the plaintext leg when encrypting, and the response is the plaintext leg when decrypting. */
+
+	error = receiveText(clientsocketfd, messageBuffer, messageLength, legOptions(options, server_type == 'e')); /* Read the whole message while checking for errors.*/
+
+	if (error < 0 || (size_t)error < messageLength) /* If there is an error or the message was cut short, the server failed to read the message from the socket. */
+	{
+		fprintf(stderr, "Failed to read the message from the socket. Unknown error.\n");
+		cleanup(clientsocketfd, keyBuffer, messageBuffer); /* Clear file descriptors, close socket, and free any memory. */
+		exit(2);
+	}
+
+	/* A large request is handed to the threads, which receive the key, check it and send the response a slice at a time. */
+
+	if (splitSize > 0 && messageLength >= splitSize && computeThreads > 1)
+	{
+		serveInParallel(clientsocketfd, messageBuffer, keyBuffer, messageLength, server_type, options);
+		return;
+	}
+
+	error = receiveText(clientsocketfd, keyBuffer, messageLength, legOptions(options, false)); /* Read the whole key while checking for errors. */
+
+	if (error < 0 || (size_t)error < messageLength) /* If there is an error or the key was cut short, the server failed to read the key from the socket.*/
+	{
+		fprintf(stderr, "Failed to read from socket");
+		cleanup(clientsocketfd, keyBuffer, messageBuffer); /* Clear file descriptors, close socket, and free any memory. */
+		exit(2);
+	}
+
+	/* The client validates its files, but the server should not trust whatever arrives on the socket. If the message or the key has
+	   a character outside the alphabet, we close the connection without a response, which the client reports as a rejection. */
+
+	size_t badOffset = findInvalidCharacter(messageBuffer, messageLength);
+
+	if (badOffset == messageLength)
+	{
+		badOffset = findInvalidCharacter(keyBuffer, messageLength);
+	}
+
+	if (badOffset != messageLength)
+	{
+		fprintf(stderr, "Rejecting connection. Invalid character at offset %zu.\n", badOffset);
+		cleanup(clientsocketfd, keyBuffer, messageBuffer);
+		exit(2);
+	}
+	
+	/* Now we call the actual OTP (One Time Pad) function do the actual encryption / decryption, and write the result back to the message buffer. */
+
+	OTP(messageLength, keyBuffer, messageBuffer, server_type);
+
+	error = sendText(clientsocketfd, messageBuffer, messageLength, legOptions(options, server_type == 'd')); /* After storing the result in the messageBuffer, we write the response back to the client while error checking.*/
+	
+	if (error < 0) /* If there was an error, the server somehow failed to write back to the socket.*/
+	{
+		fprintf(stderr, "Failed writing to socket."); 
+	}
+	
+	/* If the program has reached this point, it has done it's job, so we call clean up to clear file descriptors, close the socket, and free memory. 
+	   The porgram can then exit successfully. */
+
+	cleanup(clientsocketfd, keyBuffer, messageBuffer); /* Call cleanup.*/
+}
+
+/****************************
+**                         bool restartServer(int socketfd)
+** Description: Starts a new copy of the server that inherits the listening socket, then drains and exits. The new server
+** is started through a double fork so that it is not our child, which lets us wait for our in-flight children without also 
+** waiting on the new server. A close-on-exec pipe tells us if the exec worked: it closes without data if it did, and 
+** carries the errno if it did not. If anything fails, we return false and the old server keeps running. 
+****************************/
+
+bool restartServer(int socketfd)
+{
+	int statusPipe[2]; /* Read and write ends of the pipe used to report exec failures. */
+	int execError = 0; /* Holds the errno reported by the new server if the exec failed. */
+	char socketString[16]; /* The listening socket file descriptor as a string for the environment. */
+	pid_t pid;
+
+	if (pipe(statusPipe) == -1)
+	{
+		fprintf(stderr, "Failed to create the restart pipe. Not restarting.\n");
+		return false;
+	}
+
+	fcntl(statusPipe[1], F_SETFD, FD_CLOEXEC); /* The write end closes by itself when the exec succeeds. */
+	fcntl(socketfd, F_SETFD, 0); /* Make sure the listening socket survives the exec. */
+
+	signal(SIGCHLD, SIG_DFL); /* endingChild blocks on any child, so turn it off while we wait for the intermediate child ourselves. */
+
+	pid = fork();
+
+	if (pid == -1)
+	{
+		fprintf(stderr, "Failed to fork for the restart. Not restarting.\n");
+		close(statusPipe[0]);
+		close(statusPipe[1]);
+		signal(SIGCHLD, endingChild);
+		return false;
+	}
+
+	if (pid == 0) /* Intermediate child, which forks the new server and exits right away. */
+	{
+		close(statusPipe[0]);
+
+		if (fork() == 0) /* Grandchild, which becomes the new server. */
 		{
-			continue; /* Continue to the next iteration of the loop. */
+			sprintf(socketString, "%d", socketfd);
+			setenv("OTP_LISTEN_FD", socketString, 1);
+			signal(SIGCHLD, SIG_DFL); /* The new server installs its own handlers in main. */
+			execvp(serverArguments[0], serverArguments); /* execvp so that the binary currently on disk is the one that runs. */
+
+			execError = errno; /* This point can only be reached if the exec failed, so report it through the pipe. */
+			write(statusPipe[1], &execError, sizeof(execError));
+			_exit(1);
 		}
+
+		_exit(0);
+	}
+
+	close(statusPipe[1]);
+	waitpid(pid, NULL, 0); /* Reap the intermediate child. The new server has been adopted by init. */
+
+	if (read(statusPipe[0], &execError, sizeof(execError)) > 0) /* Any data in the pipe means the exec failed. */
+	{
+		fprintf(stderr, "Failed to start the new server: %s. Not restarting.\n", strerror(execError));
+		close(statusPipe[0]);
+		signal(SIGCHLD, endingChild);
+		return false;
+	}
+
+	close(statusPipe[0]);
+
+	/* The new server is accepting on the same socket now, so stop listening and wait for our in-flight children to finish. Connections that are
+	   still in the backlog are picked up by the new server, so nothing is refused along the way. */
+
+	close(socketfd);
+
+	while (waitpid(-1, NULL, 0) > 0 || errno == EINTR)
+	{
+		continue;
 	}
+
+	exit(EXIT_SUCCESS);
 }
 
+/****************************
+**                         char serverTypeFor(char clientType)
+** Description: Works out which type the server should answer with in the handshake. A single mode server always answers 
+** with its own type. A multi-mode server answers with the client's type if the client wants to encrypt or decrypt, and with
+** its own 'b' otherwise, which the client will then reject as a mismatch.
+****************************/
+
+char serverTypeFor(char clientType)
+{
+	if (SERVERTYPE == 'b' && (clientType == 'e' || clientType == 'd'))
+	{
+		return clientType;
+	}
+
+	return SERVERTYPE;
+}
 
 /****************************
-**                         void OTP(size_t messageLength, char *keyBuffer, char *messageBuffer) 
+**                         void OTP(size_t messageLength, char *keyBuffer, char *messageBuffer, char mode) 
 ** Description: Performs the actual encryption / decryption after all the network stuff and error checking is said and done. 
+** mode is 'e' to encrypt and 'd' to decrypt. 
 ****************************/
 
-void OTP(size_t messageLength, char *keyBuffer, char *messageBuffer) 
+void OTP(size_t messageLength, char *keyBuffer, char *messageBuffer, char mode) 
 {
 	/* For the entire message length, and key buffer length, replace space with [.  [ is the ASCII code right after Z. 
 	 * We then adjust the ASCII codes by subtracting from the ASCII code for 'A' from everything, such that A = 0 and 
@@ -313,12 +699,12 @@ void OTP(size_t messageLength, char *keyBuffer, char *messageBuffer)
 		keyBuffer[i] = keyBuffer[i] - 'A';
 	}
 
-	/* Now we apply the actual algorithm, using a custom CRYPT function based on the macro definition at compile time. 
+	/* Now we apply the actual algorithm, using the CRYPT function with the operation of this connection. 
 	 * In case of negative modularization, it adds 27 to wrap around the alphabet. */
 
 	for (size_t i = 0; i < messageLength; i++) 
 	{
-		CRYPT(messageBuffer[i], keyBuffer[i])
+		CRYPT(messageBuffer[i], keyBuffer[i], mode)
 			if (messageBuffer[i] < 0) {
 				messageBuffer[i] = 27 + messageBuffer[i];
 			}
@@ -348,6 +734,269 @@ void OTP(size_t messageLength, char *keyBuffer, char *messageBuffer)
 	}
 }
 
+/****************************
+**                         void scheduleBySize(size_t messageLength) 
+** Description: Puts the child serving a request in its lane, from the message length in the header. A request of up to 
+** smallJobSize characters stays at normal priority. A bigger one is niced one level for every doubling past smallJobSize, up to
+** 19, which is about shortest job first: the kernel gives a job one nice level lower about 1.25 times the CPU time. Threads 
+** started afterwards, like the ones of serveInParallel(), inherit the level. 
+****************************/
+
+void scheduleBySize(size_t messageLength)
+{
+	int niceness = 0; /* Levels below normal priority. */
+	size_t size; /* Loop control variable. */
+
+	if (smallJobSize == 0) /* -l 0 turns the lanes off. */
+	{
+		return;
+	}
+
+	for (size = smallJobSize; size < messageLength && niceness < 19; size *= 2)
+	{
+		niceness++;
+	}
+
+	if (niceness > 0 && setpriority(PRIO_PROCESS, 0, niceness) == -1)
+	{
+		fprintf(stderr, "Failed to move a request of %zu characters to the bulk lane.\n", messageLength); /* It is still served, just not behind the small ones. */
+	}
+}
+
+/****************************
+**     void serveInParallel(int clientsocketfd, char *messageBuffer, char *keyBuffer, size_t messageLength, char mode, unsigned char options)
+** Description: Serves a request of at least splitSize characters, once the message has arrived. It starts computeThreads 
+** compute threads, or one per slice if there are fewer slices than that, and, unless the response is compressed, a sending thread, and then receives the key a slice at a time, 
+** letting the compute threads know after each one. A compressed response cannot be sent in pieces, so it is sent in one go once
+** every slice is done. If the key is cut short or a thread runs into a problem, the connection is closed without the rest of 
+** the response, which the client reports as a rejection, just like for a small request. Exits directly on any error. 
+****************************/
+
+void serveInParallel(int clientsocketfd, char *messageBuffer, char *keyBuffer, size_t messageLength, char mode, unsigned char options)
+{
+	struct parallelJob job; /* Shared by all the threads of this request. */
+	size_t numberOfSlices = (messageLength + PARALLEL_SLICE - 1) / PARALLEL_SLICE;
+	long numberOfThreads = ((size_t)computeThreads < numberOfSlices) ? computeThreads : (long)numberOfSlices; /* A thread without a slice would only wait. */
+	pthread_t *computers = malloc(numberOfThreads * sizeof(pthread_t)); /* The compute threads. */
+	pthread_t sender; /* The sending thread, if there is one. */
+	bool streaming = (legOptions(options, mode == 'd') & OPTION_COMPRESSED) == 0; /* True if the response can be sent a slice at a time. */
+	unsigned char keyOptions = legOptions(options, false); /* The key is never compressed, so it can always be received a slice at a time. */
+	long started = 0; /* How many compute threads were started. */
+	bool failed; /* A copy of job.failed, taken under the lock. */
+	long i; /* Loop control variable. */
+
+	memset(&job, 0, sizeof(job));
+	job.clientsocketfd = clientsocketfd;
+	job.messageBuffer = messageBuffer;
+	job.keyBuffer = keyBuffer;
+	job.messageLength = messageLength;
+	job.mode = mode;
+	job.responseOptions = legOptions(options, mode == 'd');
+	job.numberOfSlices = numberOfSlices;
+	job.sliceDone = calloc(job.numberOfSlices, sizeof(bool));
+	pthread_mutex_init(&job.lock, NULL);
+	pthread_cond_init(&job.changed, NULL);
+
+	if (computers == NULL || job.sliceDone == NULL)
+	{
+		fprintf(stderr, "Not enough memory to split the request.\n");
+		cleanup(clientsocketfd, keyBuffer, messageBuffer);
+		exit(2);
+	}
+
+	/* A thread that is still writing when the client goes away should get an error back, not take the whole child down with SIGPIPE before the others stop. */
+
+	signal(SIGPIPE, SIG_IGN);
+
+	for (i = 0; i < numberOfThreads; i++)
+	{
+		if (pthread_create(&computers[i], NULL, computeSlices, &job) == 0)
+		{
+			started++;
+		}
+	}
+
+	if (started == 0 || (streaming && pthread_create(&sender, NULL, sendSlices, &job) != 0))
+	{
+		fprintf(stderr, "Failed to start the threads for a large request.\n");
+		pthread_mutex_lock(&job.lock);
+		job.failed = true; /* Any compute threads that did start stop as soon as they see this. */
+		pthread_cond_broadcast(&job.changed);
+		pthread_mutex_unlock(&job.lock);
+		streaming = false;
+	}
+
+	/* Receive the key a slice at a time. A packed slice is a whole number of bytes, since PARALLEL_SLICE is a multiple of 8. Only 
+	   this thread moves received forward, so it can read it without the lock. */
+
+	while (job.received < messageLength)
+	{
+		size_t length = (messageLength - job.received < PARALLEL_SLICE) ? messageLength - job.received : PARALLEL_SLICE;
+		ssize_t error;
+
+		pthread_mutex_lock(&job.lock);
+		failed = job.failed;
+		pthread_mutex_unlock(&job.lock);
+
+		if (failed)
+		{
+			break;
+		}
+
+		error = receiveText(clientsocketfd, keyBuffer + job.received, length, keyOptions);
+		pthread_mutex_lock(&job.lock);
+
+		if (error < 0 || (size_t)error < length)
+		{
+			fprintf(stderr, "Failed to read from socket");
+			job.failed = true;
+		}
+
+		else
+		{
+			job.received += length;
+		}
+
+		pthread_cond_broadcast(&job.changed);
+		pthread_mutex_unlock(&job.lock);
+	}
+
+	/* If something went wrong, the sending thread may be stuck writing to a client that is itself stuck writing the key. Shutting
+	   the socket down gets both of them out. */
+
+	pthread_mutex_lock(&job.lock);
+	failed = job.failed;
+	pthread_mutex_unlock(&job.lock);
+
+	if (failed)
+	{
+		shutdown(clientsocketfd, 2);
+	}
+
+	for (i = 0; i < started; i++) /* Once every thread has been joined, job.failed can be read without the lock again. */
+	{
+		pthread_join(computers[i], NULL);
+	}
+
+	if (streaming)
+	{
+		pthread_join(sender, NULL);
+	}
+
+	else if (!job.failed && sendText(clientsocketfd, messageBuffer, messageLength, job.responseOptions) < 0) /* A compressed response goes in one go. */
+	{
+		fprintf(stderr, "Failed writing to socket.");
+	}
+
+	pthread_cond_destroy(&job.changed);
+	pthread_mutex_destroy(&job.lock);
+	free(job.sliceDone);
+	free(computers);
+	cleanup(clientsocketfd, keyBuffer, messageBuffer);
+
+	if (job.failed)
+	{
+		exit(2);
+	}
+}
+
+/****************************
+**                         void *computeSlices(void *argument) 
+** Description: What each compute thread of a parallelJob runs. Takes the next slice once its part of the key has arrived, 
+** checks that the message and key slices are only capital letters and spaces, and runs OTP() on it. Returns once every slice 
+** has been taken, or once any thread has failed. 
+****************************/
+
+void *computeSlices(void *argument)
+{
+	struct parallelJob *job = argument;
+
+	pthread_mutex_lock(&job->lock);
+
+	while (!job->failed && job->nextSlice < job->numberOfSlices)
+	{
+		size_t slice = job->nextSlice;
+		size_t start = slice * PARALLEL_SLICE;
+		size_t length = (job->messageLength - start < PARALLEL_SLICE) ? job->messageLength - start : PARALLEL_SLICE;
+
+		if (job->received < start + length) /* Its part of the key is not here yet. */
+		{
+			pthread_cond_wait(&job->changed, &job->lock);
+			continue;
+		}
+
+		job->nextSlice++;
+		pthread_mutex_unlock(&job->lock);
+
+		bool valid = findInvalidCharacter(job->messageBuffer + start, length) == length && findInvalidCharacter(job->keyBuffer + start, length) == length;
+
+		if (valid)
+		{
+			OTP(length, job->keyBuffer + start, job->messageBuffer + start, job->mode);
+		}
+
+		pthread_mutex_lock(&job->lock);
+
+		if (!valid)
+		{
+			fprintf(stderr, "Rejecting connection. Invalid character in the characters from offset %zu.\n", start);
+			job->failed = true;
+		}
+
+		job->sliceDone[slice] = true;
+		pthread_cond_broadcast(&job->changed);
+	}
+
+	pthread_mutex_unlock(&job->lock);
+	return NULL;
+}
+
+/****************************
+**                         void *sendSlices(void *argument) 
+** Description: What the sending thread of a parallelJob runs. Sends the finished slices to the client in order, while the 
+** later ones are still being received and worked on. Returns once every slice has been sent, or once any thread has failed. 
+****************************/
+
+void *sendSlices(void *argument)
+{
+	struct parallelJob *job = argument;
+	size_t slice; /* Loop control variable. */
+
+	for (slice = 0; slice < job->numberOfSlices; slice++)
+	{
+		size_t start = slice * PARALLEL_SLICE;
+		size_t length = (job->messageLength - start < PARALLEL_SLICE) ? job->messageLength - start : PARALLEL_SLICE;
+		bool failed;
+
+		pthread_mutex_lock(&job->lock);
+
+		while (!job->failed && !job->sliceDone[slice])
+		{
+			pthread_cond_wait(&job->changed, &job->lock);
+		}
+
+		failed = job->failed;
+		pthread_mutex_unlock(&job->lock);
+
+		if (failed)
+		{
+			return NULL;
+		}
+
+		if (sendText(job->clientsocketfd, job->messageBuffer + start, length, job->responseOptions) < 0)
+		{
+			pthread_mutex_lock(&job->lock);
+			fprintf(stderr, "Failed writing to socket.");
+			job->failed = true;
+			pthread_cond_broadcast(&job->changed);
+			pthread_mutex_unlock(&job->lock);
+			return NULL;
+		}
+	}
+
+	return NULL;
+}
+
 /****************************
 **                        void cleanup(int clientsocketfd, char *keyBuffer, char *messageBuffer) 
 ** Description: Closes the socket connection to the client, closes file descriptors, and deallocates the dynamic memory 